@@ -0,0 +1,37 @@
+#ifndef COND_H
+#define COND_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+#include "OS/mutex.h"
+#include "OS/waitqueue.h"
+
+/* A condition variable, used with a mutex to wait for a change to the state that the mutex protects:
+		A task holding the mutex checks the state, and if it has to wait, calls OS_cond_wait(), which
+		releases the mutex and blocks the task as one step, then acquires the mutex again once the task is
+		woken. A task that changes the state signals the condition variable to wake one waiting task, in
+		order of priority, or broadcasts to wake them all. A woken task must check the state again, since
+		another task may have changed it before the mutex was reacquired. Signals use the same check code
+		scheme as mutexes, so a signal between the release of the mutex and the task blocking isn't lost,
+		and a signal with no tasks waiting doesn't enter the kernel. */
+typedef struct s_OS_cond_t {
+	// counter to track the number of signals and broadcasts
+	uint32_t volatile notificationCounter;
+	// tasks waiting for a signal, in order of priority
+	OS_waitqueue_t waiting;
+} OS_cond_t;
+
+/* A function that initialises a condition variable, addressed by a pointer, in preparation for use. */
+void OS_cond_initialise(OS_cond_t * cond);
+/* A function that can be called by a task holding the mutex to release it and wait for a signal. The
+   mutex is held again when it returns, with the same acquisition count. It returns straight away if
+   the task doesn't hold the mutex. */
+void OS_cond_wait(OS_cond_t * cond, OS_mutex_t * mutex);
+/* A function that can be called by a task to wake the highest priority waiting task. */
+void OS_cond_signal(OS_cond_t * cond);
+/* A function that can be called by a task to wake every waiting task. */
+void OS_cond_broadcast(OS_cond_t * cond);
+
+#endif /* COND_H */
@@ -0,0 +1,54 @@
+#ifndef EVENTFLAGS_H
+#define EVENTFLAGS_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+
+/* Options for OS_eventFlags_wait(), which can be combined:
+		By default the wait is satisfied by any of the given flags being set, with OS_EVENTFLAGS_ALL it
+		needs all of them. With OS_EVENTFLAGS_CLEAR the flags that satisfied the wait are cleared as it
+		returns, so each event is only seen once. */
+#define OS_EVENTFLAGS_ANY   0U
+#define OS_EVENTFLAGS_ALL   (1U << 0)
+#define OS_EVENTFLAGS_CLEAR (1U << 1)
+
+/* A group of 32 event flags that tasks can block on:
+		Flags are set and cleared by tasks or ISRs, and a task can wait for any or all of a set of them. The
+		waiting tasks are kept in an intrusive list through their TCBs, with the flags and options of each
+		wait stored in the task's TCB, and setting flags wakes every task that they satisfy in one pass.
+		Setting flags while no task is waiting is a single exclusive store, without entering the kernel. */
+typedef struct s_OS_eventFlags_t {
+	// the current value of the flags
+	uint32_t volatile flags;
+	// the tasks waiting for flags, in no particular order
+	_OS_tasklist_t waiting_list;
+} OS_eventFlags_t;
+
+/* A function that initialises an event flags group, addressed by a pointer, with all flags clear. */
+void OS_eventFlags_initialise(OS_eventFlags_t * group);
+/* A function that can be called by any task or ISR to set flags, waking the tasks they satisfy. */
+void OS_eventFlags_set(OS_eventFlags_t * group, uint32_t flags);
+/* A function that can be called by any task or ISR to clear flags. */
+void OS_eventFlags_clear(OS_eventFlags_t * group, uint32_t flags);
+/* A function that returns the current value of the flags. */
+uint32_t OS_eventFlags_get(OS_eventFlags_t const * group);
+/* A function that can be called by a task to wait for any or all of the given flags (see the options
+   above). Returns the flags from the given set that were set when the wait was satisfied. */
+uint32_t OS_eventFlags_wait(OS_eventFlags_t * group, uint32_t flags, uint_fast8_t options);
+
+/*========================*/
+/*      INTERNAL API      */
+/*========================*/
+
+/* Sets flags and wakes the tasks they satisfy, from handler mode. Returns non-zero if a woken task
+   should preempt the current one. */
+uint_fast8_t _OS_eventFlags_set(OS_eventFlags_t * group, uint32_t flags);
+
+/* Utility function to check whether the current flags satisfy a wait for the given flags. */
+static inline uint_fast8_t _OS_eventFlags_satisfied(uint32_t current, uint32_t flags, uint_fast8_t options) {
+	return (options & OS_EVENTFLAGS_ALL) ? ((current & flags) == flags) : ((current & flags) != 0);
+}
+
+#endif /* EVENTFLAGS_H */
@@ -21,6 +21,8 @@ uint_fast8_t OS_heap_isEmpty(OS_heap_t * heap);
 void OS_heap_insert(OS_heap_t * heap, void * value);
 /* Function to extract an item from the heap. */
 void * OS_heap_extract(OS_heap_t * heap);
+/* Function to remove a given item from anywhere in the heap. */
+uint_fast8_t OS_heap_remove(OS_heap_t * heap, void * item);
 /* Utility function to peek the head of the heap without extraction. */
 void * OS_heap_peek(OS_heap_t * heap);
 
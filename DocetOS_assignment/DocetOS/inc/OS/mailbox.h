@@ -0,0 +1,31 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "OS/queue.h"
+
+/* A mailbox for passing blocks of memory between tasks and ISRs by ownership:
+		Only a pointer to each block goes through the mailbox, so passing a block costs the same whatever
+		its size. The sender gives up the block when it posts it, and the receiver owns it once fetched,
+		so the block must not be touched by the sender afterwards. Blocks will normally come from a memory
+		pool, allocated by the sender with pool_allocate() and returned by the receiver with
+		pool_deallocate() once it is done with them. The mailbox is a message queue of pointers, so it has
+		the same blocking, hand-off and ISR rules as OS_queue_t. The store must hold capacity pointers. */
+typedef struct s_OS_mailbox_t {
+	// the queue of block pointers
+	OS_queue_t queue;
+} OS_mailbox_t;
+
+/* A function that initialises a mailbox, addressed by a pointer, with the given store of capacity
+   pointers. */
+void OS_mailbox_initialise(OS_mailbox_t * mailbox, void ** store, uint32_t capacity);
+/* A function that can be called by a task to post a block, waiting while the mailbox is full. */
+void OS_mailbox_post(OS_mailbox_t * mailbox, void * block);
+/* A function that can be called by a task or ISR to post a block. Returns 1 if the mailbox is full, in
+   which case the caller still owns the block. */
+int_fast8_t OS_mailbox_tryPost(OS_mailbox_t * mailbox, void * block);
+/* A function that can be called by a task to fetch a block, waiting while the mailbox is empty. */
+void * OS_mailbox_fetch(OS_mailbox_t * mailbox);
+/* A function that can be called by a task or ISR to fetch a block. Returns NULL if the mailbox is empty. */
+void * OS_mailbox_tryFetch(OS_mailbox_t * mailbox);
+
+#endif /* MAILBOX_H */
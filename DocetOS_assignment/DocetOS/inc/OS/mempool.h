@@ -0,0 +1,28 @@
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <stddef.h>
+
+struct mempool_item_s {
+	struct mempool_item_s *next;
+};
+typedef struct mempool_item_s mempool_item_t;
+
+typedef struct {
+	mempool_item_t *head;
+} mempool_t;
+
+#define MEMPOOL_INITIALISER { .head = 0 }
+
+/* Fixed-size block pool. Allocation and deallocation update the head of the free list with
+	 exclusive accesses, so blocks can be allocated in one task or ISR and freed in another, as
+	 when they are passed through a mailbox. Any exception between the load and the store clears
+	 the exclusive monitor, so a head that is popped and pushed back in the meantime is still
+	 detected. pool_init() is not atomic and must be called before the pool is shared. */
+void *pool_allocate(mempool_t *pool);
+void pool_deallocate(mempool_t *pool, void *block);
+void pool_init(mempool_t *pool, size_t blocksize, size_t blocks);
+
+#define pool_add pool_deallocate
+
+#endif /* MEMPOOL_H */
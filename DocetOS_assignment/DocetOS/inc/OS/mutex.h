@@ -6,6 +6,7 @@
 #include "OS/os.h"
 #include "OS/scheduler.h"
 #include "OS/heap.h"
+#include "OS/waitqueue.h"
 
 /* Defines the maximum number of waiting tasks for a mutex: 
 		The heap must be initialised by specifying a memory size.
@@ -13,25 +14,79 @@
 		running and requiring a mutex simultaneously. However, this can be easily increased or decreased.*/
 #define _OS_MUTEX_WAITINGHEAP_SIZE 10
 
+/* Enables hand-off on release:
+		When a contended mutex is released, ownership is passed straight to the highest priority waiting task
+		by the notify delegate, rather than the mutex being freed for the woken task to race for. The woken
+		task doesn't retry the acquisition, and a task that releases and re-acquires the mutex in a loop
+		can't starve the waiters. Set to 0 to free the mutex and let the woken task retry. */
+#define _OS_MUTEX_HANDOFF 1
+
+/* Flag in the owner word of a mutex, set by the kernel when a task starts waiting for the mutex.
+	 TCBs are word aligned, so bit 0 of a TCB pointer is always free. */
+#define _OS_MUTEX_CONTENDED 1UL
+
 typedef struct s_OS_mutex_t {
-	// the task that owns this mutex
-	OS_TCB_t * task;
+	/* the TCB pointer of the task that owns this mutex, or 0 if it is free, combined with the
+		 contended flag, so that releasing an uncontended mutex is a single exclusive store */
+	uint32_t volatile owner;
 	// counter to track the number of acquisitions
 	uint32_t acquireCounter;
 	// counter to track the number of task notify calls
 	uint32_t notificationCounter;
+	// next mutex in the owning task's list of held mutexes
+	struct s_OS_mutex_t * nextHeld;
 	// heap to store waiting task in order of priority (highest = first)
 	OS_heap_t waiting_heap;
 	// a memory store for the heap
 	void * waiting_heapStore[_OS_MUTEX_WAITINGHEAP_SIZE];
 } OS_mutex_t;
 
+/* Utility function to get the task that owns a mutex from its owner word, NULL if it is free. */
+static inline OS_TCB_t * _OS_mutex_owner(OS_mutex_t const * mutex) {
+	return (OS_TCB_t *)(mutex->owner & ~_OS_MUTEX_CONTENDED);
+}
+
+/* A mutex that follows the immediate priority ceiling protocol:
+		The ceiling is the priority of the highest priority task that uses the mutex. While a task holds
+		it, no other task at or below the ceiling can preempt it, so no other user of the mutex can run
+		and try to acquire it. There is therefore no inheritance and no deadlock between ceiling mutexes,
+		and acquire and release are plain stores to the mutex and the holder's own TCB, with an SVC only on
+		release if a higher priority task was held off in the meantime. Holding one also stops round-robin
+		rotation at the holder's level, and under EDF it makes the holder non-preemptible. Nested ceiling
+		mutexes must be released in the reverse order they were acquired. A task should not block or sleep
+		while holding one, but if it does, or the ceiling is set too low, an acquire that finds the mutex
+		held falls back to blocking in the mutex's wait queue until it is released. */
+typedef struct s_OS_ceilingMutex_t {
+	// the task that owns this mutex
+	OS_TCB_t * task;
+	// counter to track the number of acquisitions
+	uint32_t acquireCounter;
+	// the ceiling priority level, stored 0-indexed like TCB priorities
+	uint_fast16_t ceiling;
+	// the holder's ceiling before it acquired this mutex, restored on release
+	uint_fast16_t savedCeiling;
+	// counter to track the number of releases, and the tasks that found the mutex held
+	uint32_t notificationCounter;
+	OS_waitqueue_t waiting;
+} OS_ceilingMutex_t;
+
 /* A function that initialises a mutex, addressed by a pointer, in preparation for use,
 	 allowing for the use of a mutex directly from a mutex pointer type. */
 void OS_mutex_initialise(OS_mutex_t * mutex);
 /* A function that can be called by a task to acquire a mutex. */
 void OS_mutex_acquire(OS_mutex_t * mutex);
+/* A function that can be called by a task to acquire a mutex, waiting for at most the given number of
+   ticks. Returns 0 if the mutex was acquired, or 1 if the timeout ran out. */
+int_fast8_t OS_mutex_acquire_timeout(OS_mutex_t * mutex, uint32_t timeout);
 /* A function that can be called by a task to release a mutex. */
 void OS_mutex_release(OS_mutex_t * mutex);
 
+/* A function that initialises a ceiling mutex with the given ceiling priority level, which is
+	 1-indexed like the priority given to OS_initialiseTCB(). */
+void OS_ceilingMutex_initialise(OS_ceilingMutex_t * mutex, uint_fast8_t ceiling);
+/* A function that can be called by a task to acquire a ceiling mutex. */
+void OS_ceilingMutex_acquire(OS_ceilingMutex_t * mutex);
+/* A function that can be called by a task to release a ceiling mutex. */
+void OS_ceilingMutex_release(OS_ceilingMutex_t * mutex);
+
 #endif /* MUTEX_H */
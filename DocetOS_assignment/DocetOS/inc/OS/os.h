@@ -12,6 +12,20 @@
 /* Type definitions */
 /********************/
 
+/* Scheduler activity counters, for measuring how often the scheduler actually runs. The tick
+   counters only cover SysTick interrupts, the scheduler counters cover every source (ticks,
+   yields, sleeps, blocking calls and wakeups from interrupts). */
+typedef struct {
+	// SysTick interrupts handled, which may be fewer than elapsed ticks under tickless idle
+	uint32_t ticks;
+	// SysTick interrupts that pended PendSV, and those that didn't need to
+	uint32_t tickSchedules;
+	uint32_t tickSchedulesAvoided;
+	// scheduler passes, and those that picked a different task to the one that was running
+	uint32_t schedulerPasses;
+	uint32_t contextSwitches;
+} OS_schedulerStats_t;
+
 /* A set of numeric constants giving the appropriate SVC numbers for various callbacks. 
    If this list doesn't match the SVC dispatch table in os_asm.s, BIG TROUBLE will ensue. */
 enum OS_SVC_e {
@@ -22,8 +36,21 @@ enum OS_SVC_e {
 	OS_SVC_SLEEP,
 	OS_SVC_MUTEX_WAIT,
 	OS_SVC_MUTEX_NOTIFY,
-	OS_SVC_PRIORITY_RESTORE,
 	OS_SVC_SEMAPHORE_WAIT,
+	OS_SVC_SLEEP_UNTIL,
+	OS_SVC_WAIT_NEXT_PERIOD,
+	OS_SVC_CREATE_TASK,
+	OS_SVC_RWLOCK_WAIT,
+	OS_SVC_RWLOCK_NOTIFY,
+	OS_SVC_EVENTFLAGS_WAIT,
+	OS_SVC_EVENTFLAGS_SET,
+	OS_SVC_QUEUE_SEND,
+	OS_SVC_QUEUE_RECEIVE,
+	OS_SVC_STREAMBUFFER_WAIT,
+	OS_SVC_COND_WAIT,
+	OS_SVC_COND_NOTIFY,
+	OS_SVC_CEILINGMUTEX_WAIT,
+	OS_SVC_CEILINGMUTEX_NOTIFY,
 };
 
 /***************************/
@@ -39,6 +66,13 @@ OS_TCB_t * OS_currentTCB(void);
 /* Returns the number of elapsed systicks since the last reboot (modulo 2^32). */
 uint32_t OS_elapsedTicks(void);
 
+/* Returns the number of elapsed systicks since the last reboot as a 64-bit count that never wraps. */
+uint64_t OS_elapsedTicks64(void);
+
+/* Copies the scheduler activity counters into the given structure. The counters are updated from
+   interrupts, so the copy is taken with interrupts disabled to keep it consistent. */
+void OS_schedulerStats(OS_schedulerStats_t * const stats);
+
 
 /************************/
 /* Scheduling functions */
@@ -62,15 +96,38 @@ uint32_t OS_elapsedTicks(void);
 		_OS_schedule will the schedule the next task.*/
 #define OS_yield() _svc_0(OS_SVC_YIELD)
 
+/* SVC delegate to run the scheduler:
+		Unlike OS_yield(), the yield flag is not set, so the current task keeps its
+		place and the rest of its time slice if it is still the one to run. This is
+		used from thread mode when a task has been woken that should preempt the
+		current one. */
+#define OS_schedule() _svc_0(OS_SVC_SCHEDULE)
+
 /* SVC delegate to sleep the current task:
 		When called from within a task, the delegate will first calculate the wake up time
-	  to wake the task up, this time is stored in the data field of the TCB with the sleep
+	  to wake the task up, this time is stored in the wakeTime field of the TCB with the sleep
 		field in the status flags TCB field toggled set high. The delegate removes the task
-		from the scheduler's DL task list, and adds the task to the sleeping head, sorted by
-		order of wake time, soonest wake time at the head. PendSV bit is set to invoke a
-		context switch. */
+		from the scheduler's DL task list, and adds the task to the sleeping timing wheel in
+		the slot for its wake time. PendSV bit is set to invoke a context switch. */
 #define OS_sleep(x) _svc_1(x, OS_SVC_SLEEP)
 
+/* SVC delegate to sleep the current task until the start of its next period:
+		Takes a pointer to a uint64_t holding the tick at which the task was last released, and
+		the period in ticks. The next release time is the last release time plus the period, it
+		is written back through the pointer and the task sleeps until then (or doesn't sleep at
+		all if that time has already passed). Since the release times are computed from each
+		other rather than from the time the call is made, a periodic task's phase doesn't drift
+		with the amount of work done in each period, or with any time spent blocked. The release
+		time should be initialised from OS_elapsedTicks64() before the first call. */
+#define OS_sleepUntil(x,y) _svc_2((uint32_t)(x), y, OS_SVC_SLEEP_UNTIL)
+
+/* SVC delegate to finish the current job of a periodic task:
+		Marks the end of the job that was released at the task's release time. If the job has
+		overrun its absolute deadline, the task's deadline miss counter is incremented. The release
+		time is then advanced by the task's period and the task sleeps until then, or carries on
+		straight away if it is already late. The timing parameters are set with OS_setDeadline(). */
+#define OS_waitForNextPeriod() _svc_0(OS_SVC_WAIT_NEXT_PERIOD)
+
 /* SVC delegates for mutual exclusion features:
 		The wait delegate function for both re-entrant mutexes (denoted as mutex) and counting
 		semaphores will send tasks requesting for acquired mutexes or unavailable semaphores to
@@ -79,16 +136,70 @@ uint32_t OS_elapsedTicks(void);
 		ensure deadlocks are prevented, finally, the PendSV bit is set to invoke a context
 		switch.
 
-		The mutex notify function notifies the head of the waiting list of the mutex that the
-		mutex has been released and is ready to acquire. The delegate function can be found in
-		the mutex souce code.
+		The mutex notify function is the slow path of a release, only used once a task has
+		started waiting. It releases the mutex and notifies the head of the waiting list of the
+		mutex that the mutex has been released and is ready to acquire. The delegate function
+		can be found in the mutex souce code.
 		
-		The priority restore delegate solves priority inversion by granting the mutex-holder the
-		priority level of the highest priority waiting task to ensure prompt mutex release. */
-#define OS_mutex_wait(x,y) _svc_2(x, y, OS_SVC_MUTEX_WAIT)
-#define OS_semaphore_wait(x,y) _svc_2(x, y, OS_SVC_SEMAPHORE_WAIT)
+		Priority inversion is solved by granting the mutex-holder the priority level of the
+		highest priority waiting task to ensure prompt mutex release, passed along any chain
+		of holders blocked on further mutexes. The notify delegate recomputes the holder's
+		priority from the mutexes it still holds, and sets PendSV if the current task should
+		be preempted as a result.
+
+		The third argument of the wait delegates is the timeout in ticks, or OS_WAIT_FOREVER.
+		If it runs out first, the task is taken back out of the waiting list and woken with
+		TASK_WAIT_TIMEOUT, and a mutex holder's inherited priority is recomputed. */
+#define OS_mutex_wait(x,y,z) _svc_3(x, y, z, OS_SVC_MUTEX_WAIT)
+#define OS_semaphore_wait(x,y,z) _svc_3(x, y, z, OS_SVC_SEMAPHORE_WAIT)
 #define OS_mutex_notify(x) _svc_1(x, OS_SVC_MUTEX_NOTIFY)
-#define OS_priorityRestore(x) _svc_1(x, OS_SVC_PRIORITY_RESTORE)
+
+/* SVC delegates for reader-writer locks:
+		These follow the same check code scheme as the mutex delegates. The wait delegate blocks
+		the task in the lock's reader or writer wait queue, the notify delegate is the slow path
+		of a release and hands the lock on to the waiting tasks. See rwlock.c. */
+#define OS_rwlock_wait(x,y) _svc_2(x, y, OS_SVC_RWLOCK_WAIT)
+#define OS_rwlock_notify(x) _svc_1(x, OS_SVC_RWLOCK_NOTIFY)
+
+/* SVC delegates for ceiling mutexes:
+		These are only used when a ceiling mutex is found held, which the ceiling normally
+		prevents. The wait delegate blocks the task in the mutex's wait queue if the check code
+		still matches, the notify delegate wakes the highest priority waiting task on release.
+		See mutex.c. */
+#define OS_ceilingMutex_wait(x,y) _svc_2(x, y, OS_SVC_CEILINGMUTEX_WAIT)
+#define OS_ceilingMutex_notify(x) _svc_1(x, OS_SVC_CEILINGMUTEX_NOTIFY)
+
+/* SVC delegates for event flags:
+		The wait delegate checks the flags against the mask and options the task has stored in
+		its TCB, and blocks the task in the group's waiting list if they aren't satisfied. The
+		set delegate is used by tasks to set flags once a task is waiting, it wakes every waiting
+		task that the new flags satisfy. Both work with interrupts disabled, so that ISRs can set
+		flags directly. See eventflags.c. */
+#define OS_eventFlags_wait_svc(x) _svc_1(x, OS_SVC_EVENTFLAGS_WAIT)
+#define OS_eventFlags_set_svc(x,y) _svc_2(x, y, OS_SVC_EVENTFLAGS_SET)
+
+/* SVC delegates for message queues:
+		Items are copied into and out of the queue by the kernel with interrupts disabled, so
+		that ISRs can use the same queue. If a task is blocked on the other end, the item is
+		handed straight to or from its buffer instead. When the queue is full or empty, a task
+		is blocked in the queue's sender or receiver wait queue for up to the timeout given in
+		ticks, and if the timeout is 0, the delegate returns 1 instead. See queue.c. */
+#define OS_queue_send_svc(x,y,z) _svc_3(x, y, z, OS_SVC_QUEUE_SEND)
+#define OS_queue_receive_svc(x,y,z) _svc_3(x, y, z, OS_SVC_QUEUE_RECEIVE)
+
+/* SVC delegate for stream buffers:
+		Blocks the consumer of a stream buffer until the producer has written enough bytes, or
+		the timeout given in ticks runs out. The producer never enters the kernel to write, it
+		only wakes the consumer. See streambuffer.c. */
+#define OS_streamBuffer_wait_svc(x,y) _svc_2(x, y, OS_SVC_STREAMBUFFER_WAIT)
+
+/* SVC delegates for condition variables:
+		The wait delegate blocks the task in the condition variable's wait queue if the check
+		code taken before the mutex was released still matches. The notify delegate wakes the
+		highest priority waiting task, or all of them if the second argument is non-zero. See
+		cond.c. */
+#define OS_cond_wait_svc(x,y) _svc_2(x, y, OS_SVC_COND_WAIT)
+#define OS_cond_notify_svc(x,y) _svc_2(x, y, OS_SVC_COND_NOTIFY)
 
 
 /*========================*/
@@ -136,6 +247,20 @@ static inline uint32_t _svc_2(uint32_t const arg0, uint32_t const arg1, uint32_t
 	return r0;
 }
 
+static inline uint32_t _svc_3(uint32_t const arg0, uint32_t const arg1, uint32_t const arg2, uint32_t const svc) {
+	register uint32_t r0 __asm("r0") = arg0;
+	register uint32_t const r1 __asm("r1") = arg1;
+	register uint32_t const r2 __asm("r2") = arg2;
+	register uint32_t const r7 __asm("r7") = svc;
+	__asm (
+		"svc #0"
+	: "+&r" (r0) 									/* r0 is I/O */
+	: "r" (r1), "r" (r2), "r" (r7)	/* r1, r2 and r7 are input only */
+	: "cc", "memory", "r3", "r12", "lr"	/* Clobber list reflects calling convention */
+	);
+	return r0;
+}
+
 #ifdef OS_INTERNAL
 
 /****************/
@@ -186,9 +311,14 @@ extern OS_TCB_t const * const _OS_idleTCB_p;
 
 /* Globals */
 extern OS_TCB_t * volatile _currentTCB;
+extern OS_schedulerStats_t _OS_stats;
+/* Low 32 bits of the tick at which the sleeping wheel next needs advancing. Set by the scheduler,
+   and compared with the tick count by the SysTick handler to decide whether to pend PendSV. */
+extern uint32_t volatile _OS_nextWakeTick;
 
 /* svc */
 #define _OS_task_exit() _svc_0(OS_SVC_EXIT)
+#define OS_createTask_svc(x) _svc_1(x, OS_SVC_CREATE_TASK)
 
 /* C */
 void _OS_task_end(void);
@@ -200,6 +330,12 @@ void _task_init_switch(OS_TCB_t const * const idleTask);
 /* ISRs */
 void SysTick_Handler(void);
 
+#if _OS_TICKLESS_IDLE
+/* Tickless idle */
+void _OS_tickless_enter(uint32_t ticks);
+void _OS_tickless_exit(void);
+#endif
+
 /* SVC delegates */
 void _OS_yield_delegate(void);
 void _OS_schedule_delegate(void);
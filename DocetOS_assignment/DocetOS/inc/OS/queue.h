@@ -0,0 +1,51 @@
+#ifndef OS_QUEUE_H
+#define OS_QUEUE_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+#include "OS/waitqueue.h"
+
+/* A message queue for passing fixed-size items between tasks and ISRs:
+		Items are copied into a ring buffer that is supplied by the user, which must be at least capacity
+		times itemSize bytes long. Send and receive block the task when the queue is full or empty, and the
+		try variants return 1 instead, like the Storage/queue ring buffer. Only the try variants can be
+		used from ISRs. Blocked tasks are woken in order of priority, and a blocked receiver is given the
+		item directly by the sender (and a blocked sender has its item taken directly by the receiver), so
+		woken tasks don't need to retry. The timeout variants give up once the given number of ticks has
+		passed. Items are copied with interrupts disabled, so should be small. */
+typedef struct s_OS_queue_t {
+	// the ring buffer store, and the size of each item in bytes
+	uint8_t * store;
+	uint32_t itemSize;
+	// the maximum number of items, and the number of items in the queue
+	uint32_t capacity;
+	uint32_t count;
+	// indices of the next slot to insert into and remove from
+	uint32_t insert;
+	uint32_t remove;
+	// tasks waiting to send to a full queue, and to receive from an empty queue
+	OS_waitqueue_t senders;
+	OS_waitqueue_t receivers;
+} OS_queue_t;
+
+/* A function that initialises a queue, addressed by a pointer, with the given store, item size in
+   bytes and capacity in items. */
+void OS_queue_initialise(OS_queue_t * queue, void * store, uint32_t itemSize, uint32_t capacity);
+/* A function that can be called by a task to send an item, waiting while the queue is full. */
+void OS_queue_send(OS_queue_t * queue, void const * item);
+/* A function that can be called by a task to send an item, waiting for at most the given number of ticks
+   while the queue is full. Returns 0 if the item was sent, or 1 if the timeout ran out. */
+int_fast8_t OS_queue_send_timeout(OS_queue_t * queue, void const * item, uint32_t timeout);
+/* A function that can be called by a task or ISR to send an item. Returns 1 if the queue is full. */
+int_fast8_t OS_queue_trySend(OS_queue_t * queue, void const * item);
+/* A function that can be called by a task to receive an item, waiting while the queue is empty. */
+void OS_queue_receive(OS_queue_t * queue, void * item);
+/* A function that can be called by a task to receive an item, waiting for at most the given number of
+   ticks while the queue is empty. Returns 0 if an item was received, or 1 if the timeout ran out. */
+int_fast8_t OS_queue_receive_timeout(OS_queue_t * queue, void * item, uint32_t timeout);
+/* A function that can be called by a task or ISR to receive an item. Returns 1 if the queue is empty. */
+int_fast8_t OS_queue_tryReceive(OS_queue_t * queue, void * item);
+
+#endif /* OS_QUEUE_H */
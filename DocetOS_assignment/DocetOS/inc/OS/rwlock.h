@@ -0,0 +1,44 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+#include "OS/waitqueue.h"
+
+/* Bits of the reader-writer lock state word:
+		The low bits count the tasks holding the lock for reading. The writer bit is set while a task holds
+		it for writing. The writer waiting bit is set by the kernel while a writer is blocked, and stops new
+		readers from taking the lock, which gives writers preference. The waiting bit is set by the kernel
+		while any task is blocked, so that a release only enters the kernel when it has someone to wake. */
+#define _OS_RWLOCK_READERS        0x1FFFFFFFUL
+#define _OS_RWLOCK_WRITER_WAITING (1UL << 29)
+#define _OS_RWLOCK_WAITING        (1UL << 30)
+#define _OS_RWLOCK_WRITER         (1UL << 31)
+
+/* Flag passed to the wait delegate in bit 0 of the lock pointer, set for a writer. */
+#define _OS_RWLOCK_WAIT_WRITE     1UL
+
+typedef struct s_OS_rwlock_t {
+	// the state word, see above
+	uint32_t volatile state;
+	// counter to track the number of task notify calls
+	uint32_t volatile notificationCounter;
+	// tasks waiting to read, and tasks waiting to write, in order of priority
+	OS_waitqueue_t readers;
+	OS_waitqueue_t writers;
+} OS_rwlock_t;
+
+/* A function that initialises a reader-writer lock, addressed by a pointer, in preparation for use. */
+void OS_rwlock_initialise(OS_rwlock_t * lock);
+/* A function that can be called by a task to acquire a reader-writer lock for shared reading. */
+void OS_rwlock_acquireRead(OS_rwlock_t * lock);
+/* A function that can be called by a task to release a reader-writer lock that it holds for reading. */
+void OS_rwlock_releaseRead(OS_rwlock_t * lock);
+/* A function that can be called by a task to acquire a reader-writer lock for exclusive writing. */
+void OS_rwlock_acquireWrite(OS_rwlock_t * lock);
+/* A function that can be called by a task to release a reader-writer lock that it holds for writing. */
+void OS_rwlock_releaseWrite(OS_rwlock_t * lock);
+
+#endif /* RWLOCK_H */
@@ -3,22 +3,46 @@
 
 #include <stdint.h>
 
-/* Defines the maximum number of sleeping tasks: 
-		The heap must be initialised by specifying a memory size.
-		20 seems to be a reasonable size since this is an embedded OS and there shouldn't be too many tasks
-		running and requiring to sleep. However, this can be easily increased or decreased.*/
-#define _OS_SLEEPINGHEAP_SIZE 20
-
 /* Defines the maximum number of priority levels: 
 		The array must be initialised by specifying a memory size. The numeric values that denote the priority
 		level follows 'priority inversion' where smaller numeric values denote higher priorities. Priority levels
 		are 1-indexed until when it is stored in the TCB field and used for array manipulation logic, where it is
-		changed to 0-indexed. */
+		changed to 0-indexed. The ready-task lookup in the scheduler is a two-level bitmap, so this can be
+		raised to anything up to 256 levels without changing the cost of selecting the next task. */
 #define _OS_PRIORITY_LEVELS 4
 
+/* Enables tickless idle:
+		When the scheduler has nothing to run but the idle task, the SysTick period is stretched up to the
+		next event in the sleeping wheel (or the longest period the 24-bit SysTick counter allows), so
+		the idle task's WFI is not woken every millisecond. The elapsed ticks are corrected when the CPU is
+		woken early by any other interrupt. Set to 0 to keep a fixed 1ms tick. */
+#define _OS_TICKLESS_IDLE 1
+
+/* Defines the default round-robin time slice, in ticks:
+		A running task keeps the CPU for this many ticks before it is rotated behind the other ready tasks at
+		its priority level (or with its deadline, under EDF), unless it blocks, sleeps or yields first. Larger
+		values mean fewer context switches between CPU-bound tasks, smaller values mean equal-priority tasks
+		respond sooner. It can be changed for each task with OS_setTimeSlice(). A slice of 0 rotates the tasks
+		on every scheduler pass. */
+#define _OS_TIMESLICE_DEFAULT 10
+
+/* Selects the scheduling policy:
+		0 selects fixed-priority round-robin over the priority levels above. 1 selects earliest-deadline-first,
+		where the ready task with the earliest absolute deadline always runs, and priorities are only used to
+		order mutex waiters. Tasks without a deadline (see OS_setDeadline()) run in the background behind every
+		task that has one. Deadlines are tracked, and misses counted, under both policies. */
+#define _OS_SCHEDULER_EDF 0
+
+#if (_OS_PRIORITY_LEVELS < 1) || (_OS_PRIORITY_LEVELS > 256)
+#error "_OS_PRIORITY_LEVELS must be between 1 and 256"
+#endif
+
 /*========================*/
 /*      EXTERNAL API      */
 /*========================*/
+struct s_OS_mutex_t;
+struct s_OS_waitqueue_t;
+
 typedef struct s_OS_TCB_t {
 	/* Task stack pointer. It's important that this is the first entry in the structure,
 	   so that a simple double-dereference of a TCB pointer yields a stack pointer. */
@@ -29,14 +53,65 @@ typedef struct s_OS_TCB_t {
 	uint32_t volatile state;
 	/* This is a generic field that can be used to store other things of various types. */
 	uint32_t data;
+	/* This field contains the absolute tick at which a sleeping task is to be woken. It is 64-bit so
+		 that wake times are ordered correctly for any sleep duration and never wrap. */
+	uint64_t wakeTime;
 	/* This field contains the priority level of this task. */
 	uint_fast8_t volatile priority;
 	/* This field contains the original priority level of this task prior to mutex-inheritance
 		 promotion. Must not be modified outside of OS_initialiseTCB()! */
 	uint_fast8_t originalPriority;
+	/* This field contains the preemption threshold of this task, stored 0-indexed like the priority.
+		 While the task is running, only tasks of a strictly higher priority than this can preempt it. */
+	uint_fast8_t preemptionThreshold;
+	/* This field contains the ceiling of the ceiling mutexes held by this task, stored 0-indexed, or
+		 _OS_PRIORITY_LEVELS if it holds none. It is only written by the task itself (see mutex.h). */
+	uint_fast16_t volatile ceiling;
 	/* Next and prev tasks fields for linked-list behaviour. */
 	struct s_OS_TCB_t * prev;
 	struct s_OS_TCB_t * next;
+	/* Timing parameters of a periodic or deadline-constrained task, in ticks (see OS_setDeadline()).
+		 A relative deadline of zero means the task has no deadline. The release is the tick at which the
+		 current job of the task started, and the absolute deadline is the tick by which it must finish.
+		 Under EDF, the absolute deadline may be brought forward by mutex inheritance. */
+	uint32_t relativeDeadline;
+	uint32_t period;
+	uint64_t release;
+	uint64_t absoluteDeadline;
+	/* This field counts the number of jobs of this task that finished after their deadline. */
+	uint32_t deadlineMisses;
+	/* Round-robin time slice of this task in ticks, and the number of ticks left of its current
+		 slice, which is counted down by the SysTick handler while the task is running. */
+	uint32_t timeSlice;
+	uint32_t volatile sliceRemaining;
+	/* The outcome of the last blocking wait of this task, set by the kernel (see TASK_WAIT_*). */
+	uint32_t volatile waitStatus;
+	/* Intrusive links for the sleeping timing wheel. These are separate from the list links above so
+		 that a task can sit in the wheel and in another list at the same time. timerPrev points at the
+		 pointer that points at this task, and is NULL when the task is not in the wheel. */
+	struct s_OS_TCB_t * timerNext;
+	struct s_OS_TCB_t ** timerPrev;
+	/* The mutexes held by this task, linked through their nextHeld fields, and the mutex this task
+		 is waiting for, if any. These let priority inheritance follow chains of nested mutexes. */
+	struct s_OS_mutex_t * heldMutexes;
+	struct s_OS_mutex_t * blockedOn;
+	/* The memory pool that this TCB and its stack were allocated from by OS_createTask(), or NULL
+		 for a statically allocated task. */
+	void * pool;
+	/* The flags and options of the event flags wait this task is blocked in, and once the wait is
+		 satisfied, the flags that satisfied it (see eventflags.h). */
+	uint32_t volatile eventFlags;
+	uint_fast8_t eventOptions;
+	/* The caller's buffer of the queue operation this task is blocked in, which the kernel copies to
+		 or from when it hands an item over (see queue.h). */
+	void * waitBuffer;
+	/* The object a task is blocked on with a timeout, and the function the scheduler calls to take
+		 the task out of it if the timeout runs out first (see _OS_block_timeout()). */
+	void * waitObject;
+	uint_fast8_t (* waitCancel)(struct s_OS_TCB_t * task);
+	/* The wait queue this task is blocked in, if any, so that it can be re-sorted when its priority
+		 is changed by mutex inheritance (see waitqueue.h). */
+	struct s_OS_waitqueue_t * waitQueue;
 } OS_TCB_t;
 
 
@@ -60,6 +135,28 @@ void OS_initialiseTCB(OS_TCB_t * TCB, uint32_t * const stack, void (* const func
 
 void OS_addTask(OS_TCB_t * const tcb);
 
+/* Sets the timing parameters of a task, in ticks. The relative deadline is the time from each
+   release of the task to the point by which it should have finished its work and called
+   OS_waitForNextPeriod(), the period is the time between releases. This must be called after
+   OS_initialiseTCB() and before OS_addTask(), and the first release is the time of the call. */
+void OS_setDeadline(OS_TCB_t * const tcb, uint32_t const relativeDeadline, uint32_t const period);
+
+/* Sets the round-robin time slice of a task, in ticks, overriding _OS_TIMESLICE_DEFAULT. This
+   should be called after OS_initialiseTCB() and before OS_addTask(). */
+void OS_setTimeSlice(OS_TCB_t * const tcb, uint32_t const ticks);
+
+/* Sets the preemption threshold of a task, as a 1-indexed priority level like the one given to
+   OS_initialiseTCB(). Once the task is running, ready tasks with priorities from its own up to
+   and including the threshold can't preempt it, they have to wait until it blocks, sleeps, yields
+   or uses up its time slice. Giving a group of cooperating tasks a threshold equal to the highest
+   priority in the group stops them preempting each other. The threshold defaults to the task's
+   own priority, and a threshold below it is ignored. It has no effect under EDF. This should be
+   called after OS_initialiseTCB() and before OS_addTask(). */
+void OS_setPreemptionThreshold(OS_TCB_t * const tcb, uint_fast8_t const threshold);
+
+/* Timeout value, in ticks, for blocking functions that take one, to wait with no timeout. */
+#define OS_WAIT_FOREVER UINT32_MAX
+
 /*========================*/
 /*      INTERNAL API      */
 /*========================*/
@@ -75,12 +172,47 @@ typedef struct {
 void list_push_sl(_OS_tasklist_t * list, OS_TCB_t * task);
 OS_TCB_t * list_pop_head_sl(_OS_tasklist_t * list);
 OS_TCB_t * list_pop_tail_sl(_OS_tasklist_t * list);
+OS_TCB_t * list_take_all_sl(_OS_tasklist_t * list);
 
 extern _OS_tasklist_t pending_list;
 
+/* Makes a blocked task ready by pushing it onto the pending list. Returns non-zero if the task
+   should preempt the running one, in which case the caller must invoke the scheduler. */
+uint_fast8_t _OS_wake(OS_TCB_t * task);
+
+/* Takes the current task out of the ready lists and sets PendSV. The caller must keep track of the
+   task so that it can be woken with _OS_wake(). Must only be called from handler mode. */
+void _OS_block(void);
+
+/* Blocks the current task like _OS_block(), and unless the timeout is OS_WAIT_FOREVER, also puts it
+   in the sleeping wheel for that many ticks. If the timeout runs out before the task is woken, the
+   scheduler calls the cancel function with interrupts disabled to take the task out of the object
+   in its waitObject field, and makes it ready with TASK_WAIT_TIMEOUT. The cancel function must
+   return 0 if the task has already been taken out of the object to be woken. Must only be called
+   from an SVC delegate. */
+void _OS_block_timeout(uint32_t timeout, uint_fast8_t (* cancel)(OS_TCB_t * task));
+
+/* Converts a timeout in ticks to the tick at which it runs out, for blocking functions that may have
+   to wait more than once, or UINT64_MAX for OS_WAIT_FOREVER. */
+uint64_t _OS_timeout_deadline(uint32_t timeout);
+/* Returns the number of ticks left until a deadline from _OS_timeout_deadline(), 0 if it has passed,
+   or OS_WAIT_FOREVER if there is no deadline. */
+uint32_t _OS_timeout_remaining(uint64_t deadline);
+
+/* Recomputes a task's inherited priority from the mutexes it still holds, after it has released
+   one. Returns non-zero if the priority changed. */
+uint_fast8_t _OS_inheritance_restore(OS_TCB_t * task);
+
 /* Constants that define bits in a thread's 'state' field. */
 #define TASK_STATE_YIELD    (1UL << 0) // Bit zero is the 'yield' flag
 #define TASK_STATE_SLEEP    (1UL << 1) // Bit one is the 'sleep' flag
+#define TASK_STATE_READY    (1UL << 2) // Bit two is set while the task is in the ready lists
+#define TASK_STATE_DEFERRED (1UL << 3) // Bit three is set while a higher priority task is held off
+
+/* Constants for a thread's 'waitStatus' field. */
+#define TASK_WAIT_NOTIFIED  0UL // Woken by a notify, the task must retry its acquisition
+#define TASK_WAIT_HANDOFF   1UL // Woken with the mutex, semaphore token or queue item already handed to it
+#define TASK_WAIT_TIMEOUT   2UL // Woken because the timeout of the wait ran out
 
 #endif /* os_internal */
 
@@ -6,6 +6,13 @@
 #include "OS/os.h"
 #include "OS/scheduler.h"
 
+/* Enables hand-off on release:
+		When a semaphore is released while tasks are waiting for it, the token is passed straight to the
+		longest waiting task instead of being added to the count, so the woken task doesn't retry the
+		acquisition and can't be beaten to the token by another task. Set to 0 to add the token to the
+		count and let the woken task retry. */
+#define _OS_SEMAPHORE_HANDOFF 1
+
 typedef struct s_OS_semaphore_t {
 	// counter to track the number of acquisitions
 	uint32_t tokenCounter;
@@ -20,9 +27,14 @@ typedef struct s_OS_semaphore_t {
 void OS_semaphore_initialise(OS_semaphore_t * semaphore, uint32_t totalTokens);
 /* A function that can be called by a task to acquire a semaphore. */
 void OS_semaphore_acquire(OS_semaphore_t * semaphore);
+/* A function that can be called by a task to acquire a semaphore, waiting for at most the given number
+   of ticks. Returns 0 if a token was acquired, or 1 if the timeout ran out. */
+int_fast8_t OS_semaphore_acquire_timeout(OS_semaphore_t * semaphore, uint32_t timeout);
 /* A function that can be called by a task to release a semaphore. */
 void OS_semaphore_release(OS_semaphore_t * semaphore);
-/* A function that notifies a task on semaphore release. */
-void _OS_semaphore_notify(OS_semaphore_t * semaphore);
+/* A function that notifies a task on semaphore release, returns 1 if it should preempt. */
+uint_fast8_t _OS_semaphore_notify(OS_semaphore_t * semaphore);
+/* A function that invokes the scheduler after a release if the woken task should preempt. */
+void _OS_semaphore_preempt(uint_fast8_t preempt);
 
 #endif /* SEMAPHORE_H */
@@ -0,0 +1,51 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+
+/* A sequence lock, for small shared data that is read far more often than it is written:
+		A writer makes the sequence number odd for the duration of its write and even again afterwards.
+		A reader notes the sequence number, copies the data, and checks that the number is unchanged
+		and even, retrying the copy if not. Readers never write to the lock, block or enter the kernel,
+		so reads cost a few loads and can be made from ISRs. Writers raise their ceiling to the highest
+		priority for the duration of the write, in the same way as a ceiling mutex, so no task can run
+		while a write is in progress and task readers never need more than one retry. A write section
+		must be short, and a task must not block or sleep inside one. An ISR that interrupts a write
+		sees an odd number on every retry, so it must not loop on OS_seqlock_readRetry(), it should
+		keep whatever it read last time instead. Written data should be copied into the structure by
+		the writer rather than pointed to, since readers may copy it while it is being changed. */
+typedef struct s_OS_seqlock_t {
+	// the sequence number, odd while a write is in progress
+	uint32_t volatile sequence;
+	// the writer's ceiling before it started writing, restored when it finishes
+	uint_fast16_t savedCeiling;
+} OS_seqlock_t;
+
+/* A function that initialises a sequence lock, addressed by a pointer, in preparation for use. */
+void OS_seqlock_initialise(OS_seqlock_t * lock);
+/* A function that can be called by a task to start writing the data protected by a sequence lock. */
+void OS_seqlock_writeBegin(OS_seqlock_t * lock);
+/* A function that can be called by a task to finish writing the data protected by a sequence lock. */
+void OS_seqlock_writeEnd(OS_seqlock_t * lock);
+
+/* Starts a read of the data protected by a sequence lock, returning the sequence number to pass to
+   OS_seqlock_readRetry() once the data has been copied. */
+static inline uint32_t OS_seqlock_readBegin(OS_seqlock_t const * lock) {
+	uint32_t const sequence = lock->sequence;
+	// the data must not be loaded before the sequence number
+	__DMB();
+	return sequence;
+}
+
+/* Finishes a read of the data protected by a sequence lock, returning non-zero if a write was in
+   progress or has happened since OS_seqlock_readBegin(), in which case the copy must be discarded. */
+static inline uint_fast8_t OS_seqlock_readRetry(OS_seqlock_t const * lock, uint32_t const sequence) {
+	// the data must have been loaded before the sequence number is checked again
+	__DMB();
+	return (sequence & 1UL) || (lock->sequence != sequence);
+}
+
+#endif /* SEQLOCK_H */
@@ -0,0 +1,47 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+
+/* A stream buffer for passing a stream of bytes from one producer to one consumer:
+		The producer is normally an ISR, such as a peripheral receive interrupt, and the consumer a task
+		that drains the bytes in bulk. It is a ring of bytes in a store supplied by the user, where the
+		producer only writes the head index and the consumer only writes the tail index, so neither side
+		needs a lock, and the producer never enters the kernel to write. The store holds one byte fewer
+		than its size. The consumer can block until the trigger level of bytes is available, so it isn't
+		woken for every byte, or until a timeout runs out. There must only be one producer and one
+		consumer at a time. */
+typedef struct s_OS_streamBuffer_t {
+	// the byte store and its size
+	uint8_t * store;
+	uint32_t size;
+	// index of the next byte to write, only written by the producer
+	uint32_t volatile head;
+	// index of the next byte to read, only written by the consumer
+	uint32_t volatile tail;
+	// the number of bytes that wakes a blocked consumer
+	uint32_t trigger;
+	// the number of bytes the blocked consumer is waiting for, at most the trigger level
+	uint32_t volatile waitLevel;
+	// the blocked consumer, or NULL, claimed with an exclusive store by whichever side wakes it
+	OS_TCB_t * volatile waiter;
+} OS_streamBuffer_t;
+
+/* A function that initialises a stream buffer, addressed by a pointer, with the given store and size
+   in bytes, and the trigger level in bytes at which a blocked consumer is woken. */
+void OS_streamBuffer_initialise(OS_streamBuffer_t * buffer, void * store, uint32_t size, uint32_t trigger);
+/* A function that can be called by the producer, from an ISR or a task, to write bytes without
+   blocking. Returns the number of bytes written, which is less than the length if the buffer fills. */
+uint32_t OS_streamBuffer_send(OS_streamBuffer_t * buffer, void const * data, uint32_t length);
+/* A function that can be called by the consumer task to read up to the given number of bytes. If
+   fewer than the trigger level (or the given length, if that is smaller) are available, it waits
+   for them for up to the timeout in ticks, which can be 0 or OS_WAIT_FOREVER. Returns the number of
+   bytes read, which may be fewer than asked for if the timeout ran out. */
+uint32_t OS_streamBuffer_receive(OS_streamBuffer_t * buffer, void * data, uint32_t length, uint32_t timeout);
+/* A function that returns the number of bytes available to read. */
+uint32_t OS_streamBuffer_available(OS_streamBuffer_t const * buffer);
+
+#endif /* STREAMBUFFER_H */
@@ -0,0 +1,45 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "OS/scheduler.h"
+
+#include <stdint.h>
+
+/* Defines the size classes of the dynamic task pools:
+		Each dynamically created task takes one block from a pool, holding its TCB followed by its stack.
+		There is one pool per size class, with the stack size of each class in words (in ascending order)
+		and the number of blocks in it. A task gets a block from the smallest class that fits the stack
+		it asks for, moving up a class if that one is used up. The pools are carved out of the 16KB static
+		allocator the first time a task is created, so the totals must fit in that. */
+#define _OS_TASK_POOL_CLASSES 3
+#define _OS_TASK_POOL_STACK_WORDS { 128, 256, 512 }
+#define _OS_TASK_POOL_BLOCKS { 4, 2, 1 }
+
+/* Creates a task from the dynamic task pools and adds it to the scheduler. The task runs func with
+   data as its argument, at the given priority (1-indexed, as for OS_initialiseTCB()), on a stack of
+   at least stackWords 32-bit words. When the task function returns, the TCB and stack go back to
+   their pool once the task has been switched away from. Can be called from main() before OS_start(),
+   or from a task. Returns a pointer to the new TCB, or NULL if no block big enough is free. */
+OS_TCB_t * OS_createTask(void (* const func)(void const * const), void const * const data, uint_fast8_t const priority, uint32_t const stackWords);
+
+/*========================*/
+/*      INTERNAL API      */
+/*========================*/
+
+#ifdef OS_INTERNAL
+
+/* Arguments of OS_createTask(), passed to its SVC delegate by pointer since there are more than
+   two of them. */
+typedef struct {
+	void (* func)(void const * const);
+	void const * data;
+	uint_fast8_t priority;
+	uint32_t stackWords;
+} _OS_taskParams_t;
+
+/* Returns the memory of an exited pooled task to its pool. Must only be called from handler mode. */
+void _OS_task_free(OS_TCB_t * tcb);
+
+#endif /* OS_INTERNAL */
+
+#endif /* TASK_H */
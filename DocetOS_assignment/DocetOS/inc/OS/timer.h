@@ -0,0 +1,61 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+
+/* Defines the timer daemon:
+		Software timers are run by a single daemon task, which calls the callback of each timer as it
+		expires, in order of expiry time. The daemon's priority should be at least that of the most
+		urgent job run from a timer, and its stack must be big enough for the deepest callback, since
+		all callbacks share it. The stack comes from the task pools (see task.h). */
+#define _OS_TIMER_DAEMON_PRIORITY 1
+#define _OS_TIMER_DAEMON_STACK_WORDS 256
+
+/* Defines the number of timer commands that can be queued for the daemon before senders have to wait
+	 (or, from ISRs, fail). There is no limit on the number of running timers, since they are linked
+	 through their own next fields. */
+#define _OS_TIMER_COMMAND_QUEUE_SIZE 8
+
+/* A software timer:
+		When a running timer expires, the daemon calls its callback with a pointer to the timer, so a
+		callback can find its data and can stop or restart its own timer. An auto-reload timer is then
+		restarted for another period, measured from when it was due rather than from when it ran, so its
+		phase doesn't drift. A one-shot timer stops. Callbacks run one at a time in the daemon task, so
+		they must be short and must not block for long, or they will delay every other timer. Timers
+		are started, stopped and reset by sending commands to the daemon, so these can be called from
+		tasks and ISRs, and the fields below must not be changed while the timer is running. */
+typedef struct s_OS_timer_t {
+	// the function called when the timer expires, and data for it
+	void (* callback)(struct s_OS_timer_t * timer);
+	void * data;
+	// the period of the timer in ticks, and whether it restarts itself when it expires
+	uint32_t period;
+	uint_fast8_t autoReload;
+	// the tick at which the timer next expires, whether it is running, and the running timer that
+	// expires after it, only used by the daemon
+	uint64_t expiry;
+	uint_fast8_t active;
+	struct s_OS_timer_t * next;
+} OS_timer_t;
+
+/* Creates the timer daemon task. Must be called once, from main() before OS_start() and before any
+   timer is started. Returns 1 if the task couldn't be created. */
+int_fast8_t OS_timer_initialiseDaemon(void);
+
+/* A function that initialises a timer, addressed by a pointer, with the callback and its data, the
+   period in ticks, and whether it reloads automatically. The timer is created stopped. */
+void OS_timer_initialise(OS_timer_t * timer, void (* callback)(OS_timer_t * timer), void * data, uint32_t period, uint_fast8_t autoReload);
+/* A function that can be called by a task or ISR to start a timer, to expire one period from now. A
+   running timer is restarted. Returns 1 if called from an ISR while the command queue is full. */
+int_fast8_t OS_timer_start(OS_timer_t * timer);
+/* A function that can be called by a task or ISR to stop a timer. Returns 1 if called from an ISR while
+   the command queue is full. */
+int_fast8_t OS_timer_stop(OS_timer_t * timer);
+/* A function that can be called by a task or ISR to restart a running timer from now, or start a
+   stopped one. Returns 1 if called from an ISR while the command queue is full. */
+int_fast8_t OS_timer_reset(OS_timer_t * timer);
+
+#endif /* TIMER_H */
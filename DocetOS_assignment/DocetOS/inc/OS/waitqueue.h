@@ -0,0 +1,45 @@
+#ifndef WAITQUEUE_H
+#define WAITQUEUE_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+
+/* A queue of blocked tasks, ordered by priority (or by deadline under EDF), for building blocking
+	 synchronisation objects on. The object keeps its own state and check code, and its SVC delegates
+	 use the internal functions below to block the current task and to wake waiters. The tasks are
+	 linked through the prev and next fields of their TCBs, which a blocked task isn't using, so there
+	 is no limit on the number of waiting tasks. Tasks of equal priority are woken in the order they
+	 started waiting. */
+typedef struct s_OS_waitqueue_t {
+	// the highest priority waiting task, NULL if no task is waiting
+	OS_TCB_t * head;
+} OS_waitqueue_t;
+
+/* A function that initialises a wait queue, addressed by a pointer, in preparation for use. */
+void OS_waitqueue_initialise(OS_waitqueue_t * queue);
+/* Utility function to check if a wait queue has no waiting tasks. */
+uint_fast8_t OS_waitqueue_isEmpty(OS_waitqueue_t * queue);
+
+/*========================*/
+/*      INTERNAL API      */
+/*========================*/
+
+/* These must only be called from handler mode, normally from an SVC delegate. */
+
+/* Function to block the current task in the wait queue. */
+void _OS_waitqueue_block(OS_waitqueue_t * queue);
+/* Function to block the current task in the wait queue with a timeout, see _OS_block_timeout(). The
+   caller must set the task's waitObject field for the cancel function. */
+void _OS_waitqueue_block_timeout(OS_waitqueue_t * queue, uint32_t timeout, uint_fast8_t (* cancel)(OS_TCB_t * task));
+/* Function to put a task that is already blocked into the wait queue, in order. */
+void _OS_waitqueue_insert(OS_waitqueue_t * queue, OS_TCB_t * task);
+/* Function to take a given task out of the wait queue, for a cancel function. Returns 0 if the task
+   isn't in the wait queue. */
+uint_fast8_t _OS_waitqueue_remove(OS_waitqueue_t * queue, OS_TCB_t * task);
+/* Function to take the highest priority task out of the wait queue, NULL if it is empty. The task
+	 must then be woken with _OS_wake(). */
+OS_TCB_t * _OS_waitqueue_pop(OS_waitqueue_t * queue);
+
+#endif /* WAITQUEUE_H */
@@ -0,0 +1,42 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include "OS/scheduler.h"
+
+#include <stdint.h>
+
+/* Defines the shape of the hierarchical timing wheel:
+		Each level has 32 slots so that a level's occupied slots fit in one 32-bit bitmap. Level 0 slots are
+		one tick wide, and each level above is 32 times coarser, so 5 levels cover 2^25 ticks (over 9 hours
+		at 1ms). Wake times further away than that are parked in the top level and cascaded back into it
+		until they come within range, so there is no limit on the sleep duration. */
+#define _OS_WHEEL_LEVELS 5
+#define _OS_WHEEL_SLOT_BITS 5
+#define _OS_WHEEL_SLOTS (1UL << _OS_WHEEL_SLOT_BITS)
+
+// Structure definition of a hierarchical timing wheel of TCBs
+typedef struct s_OS_wheel_t {
+	// slot list heads, tasks are linked through their intrusive timer fields
+	OS_TCB_t * slot[_OS_WHEEL_LEVELS][_OS_WHEEL_SLOTS];
+	// bitmap of the non-empty slots in each level (bit n = slot n)
+	uint32_t occupied[_OS_WHEEL_LEVELS];
+	// the last tick that the wheel has been advanced to
+	uint64_t time;
+	// number of tasks in the wheel
+	uint32_t count;
+} OS_wheel_t;
+
+#define OS_WHEEL_INITIALISER { .slot = {{0}}, .occupied = {0}, .time = 0, .count = 0 }
+
+/* Utility function to check if a wheel is empty. */
+uint_fast8_t OS_wheel_isEmpty(OS_wheel_t * wheel);
+/* Function to insert a task into the wheel, to expire at the wake time in its wakeTime field. */
+void OS_wheel_insert(OS_wheel_t * wheel, OS_TCB_t * task);
+/* Function to remove a task from the wheel before it expires. */
+void OS_wheel_remove(OS_wheel_t * wheel, OS_TCB_t * task);
+/* Function to advance the wheel to the given time and extract every task that has expired. */
+OS_TCB_t * OS_wheel_expire(OS_wheel_t * wheel, uint64_t now);
+/* Function to find the number of ticks until the wheel next needs to be advanced. */
+uint32_t OS_wheel_nextExpiry(OS_wheel_t * wheel);
+
+#endif /* WHEEL_H */
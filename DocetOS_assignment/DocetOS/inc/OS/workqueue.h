@@ -0,0 +1,45 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#define OS_INTERNAL
+
+#include "OS/os.h"
+#include "OS/scheduler.h"
+
+/* Defines the work queue worker:
+		Deferred work is run by a single worker task, which should be the highest priority task in the
+		system, so that work handed off by an ISR is run as soon as the ISRs have finished, but can still be
+		preempted by them. Its stack must be big enough for the deepest work function, since they all share
+		it. The stack comes from the task pools (see task.h). */
+#define _OS_WORKQUEUE_PRIORITY 1
+#define _OS_WORKQUEUE_STACK_WORDS 256
+
+/* An item of deferred work:
+		ISRs (or tasks) submit an item to have its function called with its data by the worker task, so
+		that an ISR only has to do what can't wait and can hand the rest of its processing to thread
+		context. Submitting an item is a few exclusive stores and doesn't enter the kernel unless the
+		worker has to be woken. Items are linked into the queue through their own next field, so the
+		caller owns the memory and nothing is allocated. An item can only be in the queue once, a submit
+		while it is still waiting to run is dropped, but it can be submitted again once its function has
+		started. Items submitted together are run in the order they were submitted. */
+typedef struct s_OS_work_t {
+	// the function to run in the worker task, and data for it
+	void (* function)(void * data);
+	void * data;
+	// the next item in the queue, and whether the item is in the queue
+	struct s_OS_work_t * next;
+	uint32_t volatile queued;
+} OS_work_t;
+
+/* Creates the worker task. Must be called once, from main() before OS_start(). Returns 1 if the task
+   couldn't be created. */
+int_fast8_t OS_workqueue_initialise(void);
+
+/* A function that initialises an item of work, addressed by a pointer, with the function to run and
+   its data. */
+void OS_work_initialise(OS_work_t * work, void (* function)(void * data), void * data);
+/* A function that can be called by any ISR or task to queue an item of work for the worker task.
+   Returns 1 if the item was already queued, otherwise 0. */
+int_fast8_t OS_work_submit(OS_work_t * work);
+
+#endif /* WORKQUEUE_H */
@@ -0,0 +1,101 @@
+#include "OS/cond.h"
+
+#include "stm32f4xx.h"
+
+/* A function that initialises a condition variable, addressed by a pointer, in preparation for use.
+	 Function takes in a pointer to the condition variable to initialise. */
+void OS_cond_initialise(OS_cond_t * cond) {
+	cond->notificationCounter = 0;
+	OS_waitqueue_initialise(&cond->waiting);
+}
+
+/* A function that a task holding a mutex can use to release it and wait for a condition variable to
+	 be signalled. The check code is taken while the mutex is still held, so any signal from a task that
+	 changes the state after this point changes the code, and the wait delegate won't block the task.
+	 A re-entrantly held mutex is released fully, and its acquisition count restored after it has been
+	 reacquired. As with OS_mutex_release(), a task that doesn't own the mutex returns straight away,
+	 before the count is touched, since it belongs to the owner. Function takes in a pointer to the
+	 condition variable, and a pointer to the mutex. */
+void OS_cond_wait(OS_cond_t * cond, OS_mutex_t * mutex) {
+	// check if the mutex is owned by the task that is calling this function
+	if (_OS_mutex_owner(mutex) != OS_currentTCB()) {
+		return;
+	}
+	// get and store the current condition variable notification count
+	uint32_t checkCode = cond->notificationCounter;
+	uint32_t const acquisitions = mutex->acquireCounter;
+	mutex->acquireCounter = 1;
+	OS_mutex_release(mutex);
+	OS_cond_wait_svc((uint32_t)cond, checkCode);
+	OS_mutex_acquire(mutex);
+	mutex->acquireCounter = acquisitions;
+}
+
+/* A function that signals a condition variable. The notification counter is incremented first, with
+	 an exclusive store, so that a task between releasing its mutex and blocking sees the signal. A task
+	 that blocked before then is already in the wait queue, so the kernel only needs to be entered if
+	 the queue isn't empty. Function takes in a pointer to the condition variable, and whether to wake
+	 every waiting task. */
+static void _cond_notify(OS_cond_t * cond, uint32_t broadcast) {
+	while (1) {
+		uint32_t notifications = __LDREXW (&(cond->notificationCounter));
+		if (!(__STREXW (notifications + 1, &(cond->notificationCounter)))) {
+			break;
+		}
+	}
+	if (!OS_waitqueue_isEmpty(&cond->waiting)) {
+		OS_cond_notify_svc((uint32_t)cond, broadcast);
+	}
+}
+
+/* A function that a task can use to wake the highest priority task waiting for a condition variable.
+	 Function takes in a pointer to the condition variable. */
+void OS_cond_signal(OS_cond_t * cond) {
+	_cond_notify(cond, 0);
+}
+
+/* A function that a task can use to wake every task waiting for a condition variable. Function takes
+	 in a pointer to the condition variable. */
+void OS_cond_broadcast(OS_cond_t * cond) {
+	_cond_notify(cond, 1);
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_cond_wait_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that blocks the current task on a condition variable, unless it
+	 has been signalled since the check code was taken. Function takes in a
+	 pointer to the condition variable and the check code. */
+void _OS_cond_wait_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_cond_t * cond = (OS_cond_t *) stack->r0;
+	uint32_t checkCode = stack->r1;
+	OS_currentTCB()->waitStatus = TASK_WAIT_NOTIFIED;
+	if (cond->notificationCounter == checkCode) {
+		_OS_waitqueue_block(&cond->waiting);
+	}
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_cond_notify_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that wakes the highest priority task waiting on a condition
+	 variable, or every waiting task for a broadcast, invoking the scheduler if
+	 one of them should preempt the current task. Function takes in a pointer to
+	 the condition variable, and non-zero for a broadcast. */
+void _OS_cond_notify_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_cond_t * cond = (OS_cond_t *) stack->r0;
+	uint32_t const broadcast = stack->r1;
+	uint_fast8_t preempt = 0;
+	OS_TCB_t * task;
+	while ((task = _OS_waitqueue_pop(&cond->waiting))) {
+		preempt |= _OS_wake(task);
+		if (!broadcast) {
+			break;
+		}
+	}
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
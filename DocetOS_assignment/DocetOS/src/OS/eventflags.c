@@ -0,0 +1,150 @@
+#include "OS/eventflags.h"
+
+#include "stm32f4xx.h"
+
+/* A function that initialises an event flags group, addressed by a pointer, in preparation for use.
+	 Function takes in a pointer to the group to initialise. */
+void OS_eventFlags_initialise(OS_eventFlags_t * group) {
+	group->flags = 0;
+	group->waiting_list.head = 0;
+}
+
+/* A function that sets flags in an event flags group. If no task is waiting, the flags are set with an
+	 exclusive store. Otherwise the waiting tasks must be checked by the kernel: from an ISR this is done
+	 directly, and from a task it is done by the set delegate. A task starting to wait enters the kernel,
+	 which clears the exclusive monitor, so the waiting list can't gain a task between the check and the
+	 store. Function takes in a pointer to the group, and the flags to set. */
+void OS_eventFlags_set(OS_eventFlags_t * group, uint32_t flags) {
+	while (1) {
+		uint32_t current = __LDREXW (&(group->flags));
+		if (group->waiting_list.head) {
+			__CLREX();
+			break;
+		}
+		if (!(__STREXW (current | flags, &(group->flags)))) {
+			return;
+		}
+	}
+	// the IPSR register is non-zero in handler mode, see _OS_semaphore_preempt()
+	if (__get_IPSR()) {
+		if (_OS_eventFlags_set(group, flags)) {
+			SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+		}
+	} else {
+		OS_eventFlags_set_svc((uint32_t)group, flags);
+	}
+}
+
+/* A function that clears flags in an event flags group with an exclusive store. Clearing flags can't
+	 satisfy a wait, so the waiting tasks don't need checking. Function takes in a pointer to the group,
+	 and the flags to clear. */
+void OS_eventFlags_clear(OS_eventFlags_t * group, uint32_t flags) {
+	while (1) {
+		uint32_t current = __LDREXW (&(group->flags));
+		if (!(__STREXW (current & ~flags, &(group->flags)))) {
+			return;
+		}
+	}
+}
+
+/* A function that returns the current value of the flags in an event flags group. Function takes in a
+	 pointer to the group. */
+uint32_t OS_eventFlags_get(OS_eventFlags_t const * group) {
+	return group->flags;
+}
+
+/* A function that a task can use to wait for flags in an event flags group. If the wait is already
+	 satisfied it returns straight away, clearing the flags with an exclusive store if asked to. Otherwise
+	 the flags and options are stored in the task's TCB and the wait delegate blocks the task until a set
+	 satisfies it, by which point the flags that satisfied it have been stored back in the TCB. Function
+	 takes in a pointer to the group, the flags to wait for, and the options (see eventflags.h). Returns
+	 the flags from the given set that were set when the wait was satisfied. */
+uint32_t OS_eventFlags_wait(OS_eventFlags_t * group, uint32_t flags, uint_fast8_t options) {
+	while (1) {
+		uint32_t current = __LDREXW (&(group->flags));
+		if (!_OS_eventFlags_satisfied(current, flags, options)) {
+			__CLREX();
+			break;
+		}
+		if (!(options & OS_EVENTFLAGS_CLEAR)) {
+			__CLREX();
+			return current & flags;
+		}
+		if (!(__STREXW (current & ~flags, &(group->flags)))) {
+			return current & flags;
+		}
+	}
+	OS_TCB_t * currentTCB = OS_currentTCB();
+	currentTCB->eventFlags = flags;
+	currentTCB->eventOptions = options;
+	OS_eventFlags_wait_svc((uint32_t)group);
+	return currentTCB->eventFlags;
+}
+
+/* A function that sets flags in an event flags group and wakes every waiting task that they satisfy,
+	 in a single pass over the waiting list. Flags that satisfied a wait with the clear option are only
+	 cleared after the pass, so every task waiting for the same event sees it. Interrupts are disabled
+	 throughout, so this can be called from ISRs and delegates alike. Function takes in a pointer to the
+	 group, and the flags to set. Returns 1 if a woken task should preempt the current one. */
+uint_fast8_t _OS_eventFlags_set(OS_eventFlags_t * group, uint32_t flags) {
+	uint_fast8_t preempt = 0;
+	__disable_irq();
+	uint32_t const current = group->flags | flags;
+	uint32_t consumed = 0;
+	OS_TCB_t ** link = &(group->waiting_list.head);
+	while (*link) {
+		OS_TCB_t * task = *link;
+		if (_OS_eventFlags_satisfied(current, task->eventFlags, task->eventOptions)) {
+			// unlink the task before waking it, since the pending list reuses its next field
+			*link = task->next;
+			if (task->eventOptions & OS_EVENTFLAGS_CLEAR) {
+				consumed |= current & task->eventFlags;
+			}
+			task->eventFlags = current & task->eventFlags;
+			preempt |= _OS_wake(task);
+		} else {
+			link = &(task->next);
+		}
+	}
+	group->flags = current & ~consumed;
+	__enable_irq();
+	return preempt;
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_eventFlags_wait_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that blocks the current task until a set of event flags satisfies
+	 the wait stored in its TCB. The flags are checked again with interrupts disabled,
+	 since they may have been set since the task checked them. Function takes in a
+	 pointer to the group. */
+void _OS_eventFlags_wait_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_eventFlags_t * group = (OS_eventFlags_t *) stack->r0;
+	OS_TCB_t * currentTask = OS_currentTCB();
+	__disable_irq();
+	uint32_t const current = group->flags;
+	if (_OS_eventFlags_satisfied(current, currentTask->eventFlags, currentTask->eventOptions)) {
+		if (currentTask->eventOptions & OS_EVENTFLAGS_CLEAR) {
+			group->flags = current & ~currentTask->eventFlags;
+		}
+		currentTask->eventFlags = current & currentTask->eventFlags;
+	} else {
+		_OS_block();
+		currentTask->next = group->waiting_list.head;
+		group->waiting_list.head = currentTask;
+	}
+	__enable_irq();
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_eventFlags_set_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that sets event flags for a task, once a task is waiting for them.
+	 Function takes in a pointer to the group and the flags to set. */
+void _OS_eventFlags_set_delegate(_OS_SVC_StackFrame_t * stack) {
+	if (_OS_eventFlags_set((OS_eventFlags_t *) stack->r0, stack->r1)) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
@@ -2,10 +2,11 @@
 
 #include <stdio.h>
 
-/* Internal heap function to move nodes up to maintain heap ordering. */
-static void _heap_up(OS_heap_t * heap) {
-	// start with the last node in the heap
-	uint32_t childNode = heap->size;
+/* Internal heap function to move nodes up to maintain heap ordering, starting from the given
+	 (1-indexed) node. */
+static void _heap_up(OS_heap_t * heap, uint32_t node) {
+	// start with the given node, which is the last node in the heap after an insertion
+	uint32_t childNode = node;
 	while (childNode > 1) {
 		// calculate the parent node
 		uint32_t parentNode = childNode / 2;
@@ -21,10 +22,11 @@ static void _heap_up(OS_heap_t * heap) {
 	}
 }
 
-/* Internal heap function to move nodes down to maintain heap ordering. */
-static void _heap_down(OS_heap_t * heap) {
-	// start with the root node
-	uint32_t parentNode = 1;
+/* Internal heap function to move nodes down to maintain heap ordering, starting from the given
+	 (1-indexed) node. */
+static void _heap_down(OS_heap_t * heap, uint32_t node) {
+	// start with the given node, which is the root node after an extraction
+	uint32_t parentNode = node;
 	// calculate the left child node position first
 	uint32_t leftChildNode = parentNode * 2;
 	// initialise the var to store the smallest child node
@@ -68,7 +70,7 @@ uint_fast8_t OS_heap_isEmpty(OS_heap_t * heap) {
 void OS_heap_insert(OS_heap_t * heap, void * item) {
 	// The new element is always added to the end of a heap
 	heap->heapStore[(heap->size)++] = item;
-	_heap_up(heap);
+	_heap_up(heap, heap->size);
 }
 
 /* A function to extract the head item from the heap. Function takes in a	
@@ -83,7 +85,7 @@ void * OS_heap_extract(OS_heap_t * heap) {
 		// update the index and size counter
 		heap->heapStore[0] = heap->heapStore[--(heap->size)];
 		// fill space from the end
-		_heap_down(heap);
+		_heap_down(heap, 1);
 		// return the head item
 		return item;
 	} else {
@@ -92,6 +94,25 @@ void * OS_heap_extract(OS_heap_t * heap) {
 	}
 }
 
+/* A function to remove a given item from anywhere in the heap, for example so that it can be
+	 re-inserted after the field it is ordered by has changed. The last item fills its space, and
+	 is moved up or down to restore the heap ordering. Function takes in a pointer to the heap and
+	 a pointer to the item to remove. Returns 1 if the item was found and removed, 0 otherwise. */
+uint_fast8_t OS_heap_remove(OS_heap_t * heap, void * item) {
+	for (uint32_t i = 0; i < heap->size; i++) {
+		if (heap->heapStore[i] == item) {
+			heap->heapStore[i] = heap->heapStore[--(heap->size)];
+			// the moved item may belong above or below its new position
+			if (i < heap->size) {
+				_heap_up(heap, i + 1);
+				_heap_down(heap, i + 1);
+			}
+			return 1;
+		}
+	}
+	return 0;
+}
+
 /* A function to peek the head of the heap. Function takes in a pointer
 	 to the heap to peek, returns a NULL if the heap is empty, otherwise
 	 returns the void pointer to the generic item without extracting it
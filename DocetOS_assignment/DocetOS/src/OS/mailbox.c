@@ -0,0 +1,40 @@
+#include "OS/mailbox.h"
+
+/* A function that initialises a mailbox, addressed by a pointer, in preparation for use. Function takes
+	 in a pointer to the mailbox, a pointer to the store for the block pointers, and the maximum number of
+	 blocks it can hold. */
+void OS_mailbox_initialise(OS_mailbox_t * mailbox, void ** store, uint32_t capacity) {
+	OS_queue_initialise(&mailbox->queue, store, sizeof(void *), capacity);
+}
+
+/* A function that a task can use to post a block to a mailbox, giving up ownership of it. If the mailbox
+	 is full, the task waits until a receiver takes the block. Function takes in a pointer to the mailbox
+	 and the block. */
+void OS_mailbox_post(OS_mailbox_t * mailbox, void * block) {
+	OS_queue_send(&mailbox->queue, &block);
+}
+
+/* A function that a task or ISR can use to post a block to a mailbox without waiting. Function takes in a
+	 pointer to the mailbox and the block. Returns 1 if the mailbox is full, or 0 if the block was posted. */
+int_fast8_t OS_mailbox_tryPost(OS_mailbox_t * mailbox, void * block) {
+	return OS_queue_trySend(&mailbox->queue, &block);
+}
+
+/* A function that a task can use to fetch a block from a mailbox, taking ownership of it. If the mailbox
+	 is empty, the task waits until a sender posts a block. Function takes in a pointer to the mailbox.
+	 Returns the block. */
+void * OS_mailbox_fetch(OS_mailbox_t * mailbox) {
+	void * block;
+	OS_queue_receive(&mailbox->queue, &block);
+	return block;
+}
+
+/* A function that a task or ISR can use to fetch a block from a mailbox without waiting. Function takes in
+	 a pointer to the mailbox. Returns the block, or NULL if the mailbox is empty. */
+void * OS_mailbox_tryFetch(OS_mailbox_t * mailbox) {
+	void * block;
+	if (OS_queue_tryReceive(&mailbox->queue, &block)) {
+		return 0;
+	}
+	return block;
+}
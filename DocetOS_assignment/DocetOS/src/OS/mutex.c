@@ -1,14 +1,24 @@
 #include "OS/mutex.h"
 
+#include "stm32f4xx.h"
+
 /* A generic heap is implemented to hold the list of tasks waiting for this mutex. 
 
 	 Since this is a generic heap, a use-case-specialised comparator function must be present. In
-	 this case, the function compares the priority value in the TCB's data field. Higher priority
-	 tasks (denoted with a smaller numeric value) will be ordered first. */
+	 this case, the function compares the TCB's priority field (or its absolute deadline under EDF).
+	 Higher priority tasks (denoted with a smaller numeric value) will be ordered first. The result is
+	 the sign of the comparison rather than the difference, which wouldn't fit in the return type for
+	 far apart values. */
 static int_fast8_t heapComparator (void * task1, void * task2) {
+#if _OS_SCHEDULER_EDF
+	// under EDF, the waiting task with the earliest deadline is ordered first instead
+	uint64_t taskPriority1 = ((OS_TCB_t*)task1)->absoluteDeadline;
+	uint64_t taskPriority2 = ((OS_TCB_t*)task2)->absoluteDeadline;
+#else
 	uint32_t taskPriority1 = ((OS_TCB_t*)task1)->priority;
 	uint32_t taskPriority2 = ((OS_TCB_t*)task2)->priority;
-	return (int_fast8_t)(taskPriority1 - taskPriority2);
+#endif
+	return (int_fast8_t)((taskPriority1 > taskPriority2) - (taskPriority1 < taskPriority2));
 }
 
 /* A function that initialises a mutex, addressed by a pointer, in preparation for use,
@@ -17,66 +27,222 @@ static int_fast8_t heapComparator (void * task1, void * task2) {
 void OS_mutex_initialise(OS_mutex_t * mutex) {
 	mutex->acquireCounter = 0;
 	mutex->notificationCounter = 0;
-	mutex->task = 0;
+	mutex->owner = 0;
+	mutex->nextHeld = 0;
 	mutex->waiting_heap.heapComparator = heapComparator;
 	mutex->waiting_heap.heapStore = mutex->waiting_heapStore;
 	mutex->waiting_heap.size = 0;
 }
 
-/* A function that a task can use to acquire a mutex. Exclusively loads and stores the mutex task
+/* A function that a task can use to acquire a mutex. Exclusively loads and stores the mutex owner
 	 to ensure atomic ownership assignment preserving thread safety. If a mutex is already owned by
 	 another task, the function sends the requesting task into the wait list by calling the mutex
 	 wait delegate. If the mutex is owned by the requesting task, the mutex's acquire counter is
-	 incremented. Function takes in a pointer to the mutex.*/
+	 incremented. On the first acquisition the mutex is added to the task's list of held mutexes,
+	 which only the owning task changes. Function takes in a pointer to the mutex.*/
 void OS_mutex_acquire(OS_mutex_t * mutex) {
+	OS_mutex_acquire_timeout(mutex, OS_WAIT_FOREVER);
+}
+
+/* A function that a task can use to acquire a mutex, giving up if it is still owned by another task
+	 once the timeout has run out. The acquisition works as above, and each wait is given what is left
+	 of the timeout, so a task that is woken to retry and loses the mutex again doesn't start the
+	 timeout over. Function takes in a pointer to the mutex and the timeout in ticks. Returns 0 if the
+	 mutex was acquired, or 1 if the timeout ran out. */
+int_fast8_t OS_mutex_acquire_timeout(OS_mutex_t * mutex, uint32_t timeout) {
 	// get the current OS task and store it
 	OS_TCB_t *currentTCB = OS_currentTCB();
+	uint64_t const deadline = _OS_timeout_deadline(timeout);
 	while (1) {
 		// get and store the current mutex notification count
 		uint32_t checkCode = mutex->notificationCounter;
-		// load in the mutex's TCB field
-		OS_TCB_t * mutexTask = (OS_TCB_t *) __LDREXW ((uint32_t volatile *)&(mutex->task));
-		// if the mutex's TCB field is unset, we can acquire the mutex
+		// load in the mutex's owner word, and the owning task from it
+		uint32_t owner = __LDREXW (&(mutex->owner));
+		OS_TCB_t * mutexTask = (OS_TCB_t *)(owner & ~_OS_MUTEX_CONTENDED);
+		// if the mutex has no owner, we can acquire the mutex
 		if (!mutexTask) {
-			// try to use exclusive store for TCB to get ownership of the mutex
-			if (!(__STREXW ((uint32_t)currentTCB, (uint32_t *)&(mutex->task)))) {
+			/* try to use exclusive store for TCB to get ownership of the mutex. The contended flag is
+				 kept, since other tasks may still be waiting after one has been woken. */
+			if (!(__STREXW ((uint32_t)currentTCB | (owner & _OS_MUTEX_CONTENDED), &(mutex->owner)))) {
 				// if STREXW succeeds, then current TCB has acquired the mutex, break out of while loop
 				break;
 			}
 			// if STREXW fails, then mutex is already aquired, keep iterating the while loop
 		} else if (mutexTask != currentTCB) {
+			__CLREX();
+			uint32_t const remaining = _OS_timeout_remaining(deadline);
+			if (!remaining) {
+				return 1;
+			}
 			// if the mutex is already acquired by another task, we can send it to the wait list
-			OS_mutex_wait((uint32_t)mutex, checkCode);
+			OS_mutex_wait((uint32_t)mutex, checkCode, remaining);
+#if _OS_MUTEX_HANDOFF
+			/* If the mutex was handed to this task on release, the count and held list have
+				 already been set up by the kernel. */
+			if (currentTCB->waitStatus == TASK_WAIT_HANDOFF) {
+				return 0;
+			}
+#endif
+			if (currentTCB->waitStatus == TASK_WAIT_TIMEOUT) {
+				return 1;
+			}
 		} else if (mutexTask == currentTCB) {
+			__CLREX();
 			// if the mutex is acquired by the same task, we can just increment the counter
 			break;
 		}
 	}
 	// Once everything above is finished, we can increment the counter in the mutex
-	mutex->acquireCounter++;
+	if (!(mutex->acquireCounter++)) {
+		mutex->nextHeld = currentTCB->heldMutexes;
+		currentTCB->heldMutexes = mutex;
+	}
+	return 0;
 }
 
 /* A function that a task can use to release a mutex that it owns. Function ensures that only the
 	 task owning the mutex is making the request. The mutex acquire counter is decremented and if the
-	 counter is at 0, the task's priority is restored, mutex is reset, and the highest priority waiting
-	 task for the mutex is notified. Function takes in a pointer to the mutex. */
+	 counter is at 0, the mutex is taken off the task's list of held mutexes and released. If no task
+	 has started waiting for it, nothing has been inherited through it either, so the owner word is
+	 just cleared with an exclusive store. Otherwise the notify delegate releases it, wakes the highest
+	 priority waiting task and recomputes the releasing task's inherited priority, all in one SVC.
+	 Function takes in a pointer to the mutex. */
 void OS_mutex_release(OS_mutex_t * mutex) {
+	OS_TCB_t *currentTCB = OS_currentTCB();
 	// check if the mutex is owned by the task that is calling this function
-	if (mutex->task == OS_currentTCB()) {
-		// we decrement the counter in the mutex
-		mutex->acquireCounter--;
-		// if the counter is now at 0...
-		if (!mutex->acquireCounter) {
-			// restore the mutex-holding task's priority
-			OS_priorityRestore((uint32_t)mutex->task);
-			// we reset the task field
-			mutex->task = 0;
-			// notify the OS
+	if (_OS_mutex_owner(mutex) != currentTCB) {
+		return;
+	}
+	// we decrement the counter in the mutex, there's nothing more to do unless it is now at 0
+	if (--(mutex->acquireCounter)) {
+		return;
+	}
+	// unlink the mutex from the task's held list
+	for (OS_mutex_t ** link = &currentTCB->heldMutexes; *link; link = &(*link)->nextHeld) {
+		if (*link == mutex) {
+			*link = mutex->nextHeld;
+			break;
+		}
+	}
+	mutex->nextHeld = 0;
+	while (1) {
+		uint32_t owner = __LDREXW (&(mutex->owner));
+		if (owner & _OS_MUTEX_CONTENDED) {
+			__CLREX();
+			// the slow path, the delegate invokes the scheduler itself if needed
 			OS_mutex_notify((uint32_t)mutex);
+			return;
+		}
+		// the fast path, the STREX fails if a task has started waiting since the LDREX
+		if (!(__STREXW (0, &(mutex->owner)))) {
+			return;
+		}
+	}
+}
+
+/* A function that initialises a ceiling mutex, addressed by a pointer, in preparation for use.
+	 Function takes in a pointer to the mutex and the 1-indexed ceiling priority level, an invalid
+	 ceiling is treated as the highest priority. */
+void OS_ceilingMutex_initialise(OS_ceilingMutex_t * mutex, uint_fast8_t ceiling) {
+	mutex->task = 0;
+	mutex->acquireCounter = 0;
+	mutex->ceiling = (ceiling && ceiling <= _OS_PRIORITY_LEVELS) ? (ceiling - 1) : 0;
+	mutex->savedCeiling = _OS_PRIORITY_LEVELS;
+	mutex->notificationCounter = 0;
+	OS_waitqueue_initialise(&mutex->waiting);
+}
+
+/* A function that a task can use to acquire a ceiling mutex. The task's ceiling is raised before the
+	 mutex is checked, so that no other user of the mutex can run between the check and the store. If
+	 the mutex is held anyway (the holder has blocked, or the ceiling is too low) the ceiling is put back
+	 and the task blocks until the mutex is released. Yielding instead would never let a lower priority
+	 holder run. The check code is read before the mutex, so a release in between makes the wait return
+	 straight away to retry. Function takes in a pointer to the mutex. */
+void OS_ceilingMutex_acquire(OS_ceilingMutex_t * mutex) {
+	OS_TCB_t *currentTCB = OS_currentTCB();
+	// a re-entrant acquisition only needs counting
+	if (mutex->task == currentTCB) {
+		mutex->acquireCounter++;
+		return;
+	}
+	uint_fast16_t const savedCeiling = currentTCB->ceiling;
+	uint_fast16_t const raisedCeiling = (mutex->ceiling < savedCeiling) ? mutex->ceiling : savedCeiling;
+	while (1) {
+		uint32_t const checkCode = mutex->notificationCounter;
+		currentTCB->ceiling = raisedCeiling;
+		// exclusive accesses keep the fallback safe if another user of the mutex does get to run
+		OS_TCB_t * mutexTask = (OS_TCB_t *) __LDREXW ((uint32_t volatile *)&(mutex->task));
+		if (!mutexTask) {
+			if (!(__STREXW ((uint32_t)currentTCB, (uint32_t *)&(mutex->task)))) {
+				break;
+			}
+		} else {
+			__CLREX();
+			currentTCB->ceiling = savedCeiling;
+			OS_ceilingMutex_wait((uint32_t)mutex, checkCode);
 		}
-		/* Prevents a spinlock as a task may immediately re-acquire the mutex after
-		   releasing in a tight loop. */
-		OS_yield();
+	}
+	mutex->savedCeiling = savedCeiling;
+	mutex->acquireCounter = 1;
+}
+
+/* A function that a task can use to release a ceiling mutex that it owns. When the last acquisition is
+	 released, the task's ceiling is put back to what it was before. If a task found the mutex held and
+	 is waiting for it, the notify delegate wakes it. Otherwise, if a higher priority task was made ready
+	 but held off by the ceiling, or the task's time slice ran out while it held the ceiling, the
+	 scheduler is invoked to let the other tasks run. The release is counted before the wait queue is
+	 checked, so a task that starts waiting after the check sees the new count and retries instead.
+	 Function takes in a pointer to the mutex. */
+void OS_ceilingMutex_release(OS_ceilingMutex_t * mutex) {
+	OS_TCB_t *currentTCB = OS_currentTCB();
+	if (mutex->task != currentTCB || --(mutex->acquireCounter)) {
+		return;
+	}
+	mutex->task = 0;
+	mutex->notificationCounter++;
+	currentTCB->ceiling = mutex->savedCeiling;
+	if (!OS_waitqueue_isEmpty(&mutex->waiting)) {
+		OS_ceilingMutex_notify((uint32_t)mutex);
+	} else if ((currentTCB->state & TASK_STATE_DEFERRED) || !currentTCB->sliceRemaining) {
+		OS_schedule();
+	}
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_ceilingMutex_wait_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that blocks the current task on a ceiling mutex that it found held. The task is
+	 only blocked if the check code still matches and the mutex is still held, otherwise it returns
+	 to retry. Function takes in a pointer to the mutex and the check code. */
+void _OS_ceilingMutex_wait_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_ceilingMutex_t * mutex = (OS_ceilingMutex_t *) stack->r0;
+	uint32_t checkCode = stack->r1;
+	if (mutex->notificationCounter != checkCode || !mutex->task) {
+		return;
+	}
+	_OS_waitqueue_block(&mutex->waiting);
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_ceilingMutex_notify_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that wakes the highest priority task waiting for a ceiling mutex after it has been
+	 released. The woken task retries the acquisition, since its ceiling has to be raised by the task
+	 itself. The scheduler is invoked if the woken task should preempt, or if the releasing task had
+	 a preemption held off or used up its time slice while it held the ceiling. Function takes in a
+	 pointer to the mutex. */
+void _OS_ceilingMutex_notify_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_ceilingMutex_t * mutex = (OS_ceilingMutex_t *) stack->r0;
+	OS_TCB_t const * currentTCB = OS_currentTCB();
+	uint_fast8_t preempt = (currentTCB->state & TASK_STATE_DEFERRED) || !currentTCB->sliceRemaining;
+	OS_TCB_t * waitingTask = _OS_waitqueue_pop(&mutex->waiting);
+	if (waitingTask) {
+		preempt |= _OS_wake(waitingTask);
+	}
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	}
 }
 
@@ -85,16 +251,39 @@ void OS_mutex_release(OS_mutex_t * mutex) {
    can be placed right above the function for readability. Function takes in
 	 a pointer to the mutex. */
 void _OS_mutex_notify_delegate(_OS_SVC_StackFrame_t * stack);
-/* Function to notify a waiting task on release of mutex. */
+/* Function to release a contended mutex and notify a waiting task. The releasing task's
+	 inherited priority is recomputed from the mutexes it still holds, and the scheduler is
+	 invoked if either that or the wakeup means another task should now run. Both are applied
+	 before the scheduler runs, so a woken waiter isn't overtaken by a task that only outranks
+	 the demoted holder. With hand-off enabled, the woken task is made the owner here, doing
+	 what its acquire would have done, since it is blocked and can't touch its own held list. */
 void _OS_mutex_notify_delegate(_OS_SVC_StackFrame_t * stack) {
 	// get the mutex that the task needs to wait for
 	OS_mutex_t * mutex = (OS_mutex_t *) stack->r0;
 	// increment the notification counter of the mutex
 	mutex->notificationCounter++;
+	uint_fast8_t preempt = _OS_inheritance_restore(OS_currentTCB());
 	/* Extract the head of the mutex's wait list heap, this will be the highest priority
 		 waiting task, this will then be pushed into the pending list for the scheduler to
 		 pop and schedule. */
-	if (!OS_heap_isEmpty(&mutex->waiting_heap)) {
-		list_push_sl(&pending_list, OS_heap_extract(&mutex->waiting_heap));
+	OS_TCB_t * waitingTask = OS_heap_extract(&mutex->waiting_heap);
+	// the mutex stays flagged as contended for the next owner if more tasks are waiting
+	uint32_t const contended = OS_heap_isEmpty(&mutex->waiting_heap) ? 0 : _OS_MUTEX_CONTENDED;
+	mutex->owner = contended;
+	if (waitingTask) {
+		waitingTask->blockedOn = 0;
+#if _OS_MUTEX_HANDOFF
+		mutex->owner = (uint32_t)waitingTask | contended;
+		mutex->acquireCounter = 1;
+		mutex->nextHeld = waitingTask->heldMutexes;
+		waitingTask->heldMutexes = mutex;
+		waitingTask->waitStatus = TASK_WAIT_HANDOFF;
+		// the new owner inherits from the tasks still waiting
+		_OS_inheritance_restore(waitingTask);
+#endif
+		preempt |= _OS_wake(waitingTask);
+	}
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	}
 }
@@ -19,8 +19,23 @@ static OS_TCB_t _OS_idleTCB = {
 
 OS_TCB_t const * const _OS_idleTCB_p = &_OS_idleTCB;
 
-/* Total elapsed ticks */
-static volatile uint32_t _ticks = 0;
+/* Total elapsed ticks. This is only ever written by the SysTick handler (or with interrupts
+	 disabled), but reading it takes two loads, see OS_elapsedTicks64(). */
+static volatile uint64_t _ticks = 0;
+
+#if _OS_TICKLESS_IDLE
+/* Number of SysTick counts in a single tick, set when SysTick is enabled. */
+static uint32_t _tickReload = 0;
+/* Number of ticks that the current SysTick period stands for. This is 1 except while the
+	 period has been stretched by tickless idle. */
+static volatile uint32_t _tickPeriod = 1;
+/* Number of counts that were left of the tick in progress when the current SysTick period was
+	 stretched, which the stretched period starts with. */
+static uint32_t _tickRemaining = 0;
+#endif
+
+/* Scheduler activity counters, see OS_schedulerStats(). */
+OS_schedulerStats_t _OS_stats = {0};
 
 /* GLOBAL: Holds pointer to current TCB.  DO NOT MODIFY, EVER. */
 OS_TCB_t * volatile _currentTCB = 0;
@@ -32,10 +47,27 @@ OS_TCB_t * OS_currentTCB(void) {
 
 /* Getter for the current time. */
 uint32_t OS_elapsedTicks(void) {
-	return _ticks;
+	return (uint32_t)_ticks;
 }
 
-/* IRQ handler for the system tick. Schedules PendSV 
+/* Getter for the current time as a 64-bit count. The two halves are read separately, so the
+	 read is repeated if a SysTick interrupt changed the count in between. */
+uint64_t OS_elapsedTicks64(void) {
+	uint64_t ticks;
+	do {
+		ticks = _ticks;
+	} while (ticks != _ticks);
+	return ticks;
+}
+
+/* Getter for the scheduler activity counters. */
+void OS_schedulerStats(OS_schedulerStats_t * const stats) {
+	__disable_irq();
+	*stats = _OS_stats;
+	__enable_irq();
+}
+
+/* IRQ handler for the system tick. Schedules PendSV if needed
 	
 		SysTick_Handler is called by a hardware timer, it is configured in
 		_OS_enable_systick_delegate(void) at the end of this script. It is
@@ -43,17 +75,137 @@ uint32_t OS_elapsedTicks(void) {
 
 		Each time it is triggered, it will increment the total number of
 		elapsed ticks in the OS, then it'll trigger the PendSV_Handler,
-		which will branch to _OS_schedule to schedule the next task.
+		which will branch to _OS_schedule to schedule the next task. The
+		scheduler only needs to run if something has changed since its last
+		pass: a sleeping task is due, a task has been added to the pending
+		list, or the running task's time slice has run out. Otherwise PendSV
+		is left alone, as the scheduler would pick the same task again.
 
 		The way it's currently set up, each tick is 62.5 microseconds, this is
 		how long each task will have to execute completely.
+		
+		With tickless idle, one SysTick period may stand for several ticks, so
+		_tickPeriod ticks are added, and the reload value is put back to a
+		single tick if it had been changed.
+		
+		The running task's time slice is also counted down, so the scheduler
+		knows when to rotate it behind the other tasks at the same level. The
+		idle task has no slice, and never runs during a stretched period.
 */
 
 // Local prototype - overrides weak export but is not part of the API
 void SysTick_Handler(void) {
+#if _OS_TICKLESS_IDLE
+	_ticks = _ticks + _tickPeriod;
+	_tickPeriod = 1;
+	// restore a single tick period if tickless idle has changed the reload value
+	if (SysTick->LOAD != _tickReload - 1) {
+		SysTick->LOAD = _tickReload - 1;
+		// force the counter to reload from the restored value
+		SysTick->VAL = 0;
+	}
+#else
 	_ticks = _ticks + 1;
-	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+#endif
+	_OS_stats.ticks++;
+	OS_TCB_t * const current = _currentTCB;
+	uint_fast8_t reschedule = 0;
+	/* A task's slice runs out on the tick that takes it to zero, or straight away for a zero slice.
+		 A task holding a ceiling mutex keeps running with no slice left, so the scheduler is only
+		 asked once, when the slice runs out, rather than on every tick until the mutex is released. */
+	if (current != &_OS_idleTCB) {
+		if (current->sliceRemaining) {
+			reschedule = !--current->sliceRemaining;
+		} else {
+			reschedule = current->ceiling >= _OS_PRIORITY_LEVELS;
+		}
+	}
+	// the wake tick is compared with a wrapping difference, so the check is a single 32-bit read
+	if ((int32_t)((uint32_t)_ticks - _OS_nextWakeTick) >= 0 || pending_list.head) {
+		reschedule = 1;
+	}
+	if (reschedule) {
+		_OS_stats.tickSchedules++;
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	} else {
+		_OS_stats.tickSchedulesAvoided++;
+	}
+}
+
+#if _OS_TICKLESS_IDLE
+/* Function called by the scheduler when it is about to return the idle task. Stretches the
+	 current SysTick period so that the next SysTick interrupt arrives after the given number
+	 of ticks, capped to what the 24-bit counter can hold. The remainder of the tick already
+	 in progress is kept so that tick boundaries do not drift. */
+void _OS_tickless_enter(uint32_t ticks) {
+	// longest period the 24-bit reload register can express, in whole ticks
+	uint32_t const maxTicks = (SysTick_LOAD_RELOAD_Msk + 1) / _tickReload;
+	if (ticks > maxTicks) {
+		ticks = maxTicks;
+	}
+	/* Nothing to gain from stretching the period by a single tick, and a period that has been
+		 set up by _OS_tickless_exit() to finish the tick in progress is left to run out. */
+	if (ticks <= 1 || _tickPeriod != 1) {
+		return;
+	}
+	__disable_irq();
+	// stop the counter so that the remainder of the current tick can be read
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	// if a tick is already due, let the handler run as normal
+	if (!(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+		/* The interrupt fires when the counter reaches zero, so a zero count means this tick's
+			 interrupt has already been taken and the next one is a whole reload away. */
+		uint32_t const value = SysTick->VAL;
+		uint32_t const remaining = value ? value : _tickReload;
+		// the interrupt fires LOAD + 1 counts after the counter is reloaded
+		SysTick->LOAD = remaining + ((ticks - 1) * _tickReload) - 1;
+		SysTick->VAL = 0;
+		_tickRemaining = remaining;
+		_tickPeriod = ticks;
+	}
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	__enable_irq();
+}
+
+/* Function called at the start of every scheduler pass. If the CPU was woken from a stretched
+	 SysTick period by another interrupt, the ticks that have actually elapsed are added to _ticks,
+	 and the counter is set up to finish the tick in progress, after which the SysTick handler will
+	 put back the single tick period. */
+void _OS_tickless_exit(void) {
+	// nothing to correct if the period has not been stretched
+	if (_tickPeriod == 1) {
+		return;
+	}
+	__disable_irq();
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	/* If the stretched period has run out, the handler is pending and will account for all of
+		 it. Otherwise work out how many ticks have elapsed from the counts used so far. A zero
+		 count means the counter has not reloaded from the stretched value yet. The period started
+		 with the remaining counts of the tick that was in progress, so the counts are offset by
+		 the part of that tick that had already gone, to line them up with the tick boundaries. */
+	if (!(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+		uint32_t const value = SysTick->VAL;
+		uint32_t const elapsed = value ? (SysTick->LOAD - value) : 0;
+		uint32_t const offset = elapsed + (_tickReload - _tickRemaining);
+		uint32_t const partial = offset % _tickReload;
+		_ticks = _ticks + (offset / _tickReload);
+		/* Finish the tick in progress, the handler then restores the single tick period. A reload
+			 value of zero would stop the counter, so if only one count is left, the next tick is
+			 added on and the period stands for two ticks, starting with that one count. */
+		if (partial == _tickReload - 1) {
+			SysTick->LOAD = _tickReload;
+			_tickRemaining = 1;
+			_tickPeriod = 2;
+		} else {
+			SysTick->LOAD = (_tickReload - partial) - 1;
+			_tickPeriod = 1;
+		}
+		SysTick->VAL = 0;
+	}
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	__enable_irq();
 }
+#endif
 
 /* SVC handler for OS_yield(). Sets the TASK_STATE_YIELD flag and schedules PendSV */
 void _OS_yield_delegate(void) {
@@ -87,5 +239,8 @@ void _OS_task_end(void) {
 void _OS_enable_systick_delegate(void) {
 	SystemCoreClockUpdate();
 	SysTick_Config(SystemCoreClock / 1000);
+#if _OS_TICKLESS_IDLE
+	_tickReload = SystemCoreClock / 1000;
+#endif
 	NVIC_SetPriority(SysTick_IRQn, 0x10);
 }
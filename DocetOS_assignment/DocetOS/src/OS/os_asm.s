@@ -18,8 +18,21 @@
     IMPORT OS_sleep_delegate
     IMPORT _OS_mutex_wait_delegate
     IMPORT _OS_mutex_notify_delegate
-    IMPORT _OS_priorityRestore_delegate
     IMPORT _OS_semaphore_wait_delegate
+    IMPORT OS_sleepUntil_delegate
+    IMPORT OS_waitForNextPeriod_delegate
+    IMPORT _OS_createTask_delegate
+    IMPORT _OS_rwlock_wait_delegate
+    IMPORT _OS_rwlock_notify_delegate
+    IMPORT _OS_eventFlags_wait_delegate
+    IMPORT _OS_eventFlags_set_delegate
+    IMPORT _OS_queue_send_delegate
+    IMPORT _OS_queue_receive_delegate
+    IMPORT _OS_streamBuffer_wait_delegate
+    IMPORT _OS_cond_wait_delegate
+    IMPORT _OS_cond_notify_delegate
+    IMPORT _OS_ceilingMutex_wait_delegate
+    IMPORT _OS_ceilingMutex_notify_delegate
     
 SVC_Handler
 	; r7 contains requested handler, on entry
@@ -46,8 +59,21 @@ SVC_tableStart
     DCD OS_sleep_delegate
     DCD _OS_mutex_wait_delegate
     DCD _OS_mutex_notify_delegate
-    DCD _OS_priorityRestore_delegate
     DCD _OS_semaphore_wait_delegate
+    DCD OS_sleepUntil_delegate
+    DCD OS_waitForNextPeriod_delegate
+    DCD _OS_createTask_delegate
+    DCD _OS_rwlock_wait_delegate
+    DCD _OS_rwlock_notify_delegate
+    DCD _OS_eventFlags_wait_delegate
+    DCD _OS_eventFlags_set_delegate
+    DCD _OS_queue_send_delegate
+    DCD _OS_queue_receive_delegate
+    DCD _OS_streamBuffer_wait_delegate
+    DCD _OS_cond_wait_delegate
+    DCD _OS_cond_notify_delegate
+    DCD _OS_ceilingMutex_wait_delegate
+    DCD _OS_ceilingMutex_notify_delegate
 SVC_tableEnd
 
     ALIGN
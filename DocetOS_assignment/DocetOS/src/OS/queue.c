@@ -0,0 +1,204 @@
+#include "OS/queue.h"
+
+#include "stm32f4xx.h"
+
+#include <string.h>
+
+/* A function that initialises a queue, addressed by a pointer, in preparation for use. Function takes
+	 in a pointer to the queue, a pointer to the store for its items, the size of each item in bytes, and
+	 the maximum number of items. */
+void OS_queue_initialise(OS_queue_t * queue, void * store, uint32_t itemSize, uint32_t capacity) {
+	queue->store = store;
+	queue->itemSize = itemSize;
+	queue->capacity = capacity;
+	queue->count = 0;
+	queue->insert = 0;
+	queue->remove = 0;
+	OS_waitqueue_initialise(&queue->senders);
+	OS_waitqueue_initialise(&queue->receivers);
+}
+
+/* A function that puts an item into a queue, or hands it straight to the highest priority waiting
+	 receiver. Must be called with interrupts disabled. Function takes in a pointer to the queue, a
+	 pointer to the item, and a pointer to the preempt result to update. Returns 1 if the queue is full. */
+static int_fast8_t _queue_put(OS_queue_t * queue, void const * item, uint_fast8_t * preempt) {
+	// a receiver can only be waiting if the queue is empty
+	OS_TCB_t * receiver = _OS_waitqueue_pop(&queue->receivers);
+	if (receiver) {
+		memcpy(receiver->waitBuffer, item, queue->itemSize);
+		receiver->waitStatus = TASK_WAIT_HANDOFF;
+		*preempt |= _OS_wake(receiver);
+		return 0;
+	}
+	if (queue->count == queue->capacity) {
+		return 1;
+	}
+	memcpy(queue->store + queue->insert * queue->itemSize, item, queue->itemSize);
+	queue->insert = (queue->insert + 1) % queue->capacity;
+	queue->count++;
+	return 0;
+}
+
+/* A function that takes an item out of a queue, and refills the freed slot from the highest priority
+	 waiting sender. Must be called with interrupts disabled. Function takes in a pointer to the queue, a
+	 pointer to copy the item to, and a pointer to the preempt result to update. Returns 1 if the queue is
+	 empty. */
+static int_fast8_t _queue_get(OS_queue_t * queue, void * item, uint_fast8_t * preempt) {
+	if (!queue->count) {
+		return 1;
+	}
+	memcpy(item, queue->store + queue->remove * queue->itemSize, queue->itemSize);
+	queue->remove = (queue->remove + 1) % queue->capacity;
+	queue->count--;
+	// a sender can only be waiting if the queue was full
+	OS_TCB_t * sender = _OS_waitqueue_pop(&queue->senders);
+	if (sender) {
+		memcpy(queue->store + queue->insert * queue->itemSize, sender->waitBuffer, queue->itemSize);
+		queue->insert = (queue->insert + 1) % queue->capacity;
+		queue->count++;
+		sender->waitStatus = TASK_WAIT_HANDOFF;
+		*preempt |= _OS_wake(sender);
+	}
+	return 0;
+}
+
+/* A function that takes a task whose timeout has run out out of the sender or receiver wait queue of
+	 the queue it is blocked on. It is called by the scheduler with interrupts disabled, so it can't race
+	 with a hand-off. Function takes in the task. Returns 0 if the task had already been handed its item
+	 and taken out to be woken, otherwise 1. */
+static uint_fast8_t _queue_cancel(OS_TCB_t * task) {
+	OS_queue_t * queue = task->waitObject;
+	return _OS_waitqueue_remove(&queue->senders, task) || _OS_waitqueue_remove(&queue->receivers, task);
+}
+
+/* A function that a task can use to send an item to a queue. If the queue is full, the task waits until
+	 a receiver takes the item from it. Function takes in a pointer to the queue and a pointer to the item. */
+void OS_queue_send(OS_queue_t * queue, void const * item) {
+	OS_queue_send_timeout(queue, item, OS_WAIT_FOREVER);
+}
+
+/* A function that a task can use to send an item to a queue, waiting for at most the timeout while the
+	 queue is full. The delegate clears the wait status first, so a status left over from an earlier wait
+	 isn't mistaken for this one. Function takes in a pointer to the queue, a pointer to the item, and the
+	 timeout in ticks. Returns 0 if the item was sent, or 1 if the timeout ran out. */
+int_fast8_t OS_queue_send_timeout(OS_queue_t * queue, void const * item, uint32_t timeout) {
+	if (OS_queue_send_svc((uint32_t)queue, (uint32_t)item, timeout)) {
+		return 1;
+	}
+	return OS_currentTCB()->waitStatus == TASK_WAIT_TIMEOUT;
+}
+
+/* A function that a task or ISR can use to send an item to a queue without waiting. Function takes in a
+	 pointer to the queue and a pointer to the item. Returns 1 if the queue is full, or 0 if it was sent. */
+int_fast8_t OS_queue_trySend(OS_queue_t * queue, void const * item) {
+	// the IPSR register is non-zero in handler mode, see _OS_semaphore_preempt()
+	if (!__get_IPSR()) {
+		return OS_queue_send_timeout(queue, item, 0);
+	}
+	uint_fast8_t preempt = 0;
+	__disable_irq();
+	int_fast8_t const result = _queue_put(queue, item, &preempt);
+	__enable_irq();
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+	return result;
+}
+
+/* A function that a task can use to receive an item from a queue. If the queue is empty, the task waits
+	 until a sender hands it an item. Function takes in a pointer to the queue and a pointer to copy the
+	 item to. */
+void OS_queue_receive(OS_queue_t * queue, void * item) {
+	OS_queue_receive_timeout(queue, item, OS_WAIT_FOREVER);
+}
+
+/* A function that a task can use to receive an item from a queue, waiting for at most the timeout while
+	 the queue is empty. Function takes in a pointer to the queue, a pointer to copy the item to, and the
+	 timeout in ticks. Returns 0 if an item was received, or 1 if the timeout ran out. */
+int_fast8_t OS_queue_receive_timeout(OS_queue_t * queue, void * item, uint32_t timeout) {
+	if (OS_queue_receive_svc((uint32_t)queue, (uint32_t)item, timeout)) {
+		return 1;
+	}
+	return OS_currentTCB()->waitStatus == TASK_WAIT_TIMEOUT;
+}
+
+/* A function that a task or ISR can use to receive an item from a queue without waiting. Function takes
+	 in a pointer to the queue and a pointer to copy the item to. Returns 1 if the queue is empty, or 0 if
+	 an item was received. */
+int_fast8_t OS_queue_tryReceive(OS_queue_t * queue, void * item) {
+	if (!__get_IPSR()) {
+		return OS_queue_receive_timeout(queue, item, 0);
+	}
+	uint_fast8_t preempt = 0;
+	__disable_irq();
+	int_fast8_t const result = _queue_get(queue, item, &preempt);
+	__enable_irq();
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+	return result;
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_queue_send_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that sends an item to a queue for a task. If the queue is full
+	 and the timeout isn't 0, the task is blocked in the queue's sender wait queue
+	 with its item, which a receiver will copy into the queue when it frees a
+	 slot. Function takes in a pointer to the queue, a pointer to the item, and
+	 the timeout in ticks. Returns 1 in r0 if the queue is full and the task
+	 didn't wait, otherwise 0. */
+void _OS_queue_send_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_queue_t * queue = (OS_queue_t *) stack->r0;
+	void const * item = (void const *) stack->r1;
+	uint32_t const timeout = stack->r2;
+	OS_TCB_t * currentTask = OS_currentTCB();
+	currentTask->waitStatus = TASK_WAIT_NOTIFIED;
+	uint_fast8_t preempt = 0;
+	__disable_irq();
+	int_fast8_t result = _queue_put(queue, item, &preempt);
+	if (result && timeout) {
+		currentTask->waitBuffer = (void *) item;
+		currentTask->waitObject = queue;
+		_OS_waitqueue_block_timeout(&queue->senders, timeout, _queue_cancel);
+		result = 0;
+	}
+	__enable_irq();
+	stack->r0 = (uint32_t) result;
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_queue_receive_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that receives an item from a queue for a task. If the queue is
+	 empty and the timeout isn't 0, the task is blocked in the queue's receiver
+	 wait queue, and a sender will copy its item straight into the task's buffer.
+	 Function takes in a pointer to the queue, a pointer to copy the item to, and
+	 the timeout in ticks. Returns 1 in r0 if the queue is empty and the task
+	 didn't wait, otherwise 0. */
+void _OS_queue_receive_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_queue_t * queue = (OS_queue_t *) stack->r0;
+	void * item = (void *) stack->r1;
+	uint32_t const timeout = stack->r2;
+	OS_TCB_t * currentTask = OS_currentTCB();
+	currentTask->waitStatus = TASK_WAIT_NOTIFIED;
+	uint_fast8_t preempt = 0;
+	__disable_irq();
+	int_fast8_t result = _queue_get(queue, item, &preempt);
+	if (result && timeout) {
+		currentTask->waitBuffer = item;
+		currentTask->waitObject = queue;
+		_OS_waitqueue_block_timeout(&queue->receivers, timeout, _queue_cancel);
+		result = 0;
+	}
+	__enable_irq();
+	stack->r0 = (uint32_t) result;
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
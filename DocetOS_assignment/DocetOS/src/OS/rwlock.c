@@ -0,0 +1,179 @@
+#include "OS/rwlock.h"
+
+#include "stm32f4xx.h"
+
+/* A reader-writer lock with writer preference.
+
+	 Acquiring and releasing the lock is done with exclusive accesses on the state word, the same way
+	 as a mutex, and a task only enters the kernel to wait when the lock isn't available, or on release
+	 when the waiting bit shows that there is a task to wake. Waiting uses the check code scheme: a
+	 task reads the notification counter before it looks at the state, and the wait delegate doesn't
+	 block it if the counter has changed since. When the lock becomes free the kernel hands it straight
+	 to the highest priority waiting writer, or if there are none, to every waiting reader at once, so
+	 woken tasks don't need to retry. Priority inheritance isn't applied to reader-writer locks. */
+
+/* A function that initialises a reader-writer lock, addressed by a pointer, in preparation for use.
+	 Function takes in a pointer to the lock to initialise. */
+void OS_rwlock_initialise(OS_rwlock_t * lock) {
+	lock->state = 0;
+	lock->notificationCounter = 0;
+	OS_waitqueue_initialise(&lock->readers);
+	OS_waitqueue_initialise(&lock->writers);
+}
+
+/* A function that a task can use to acquire a reader-writer lock for reading. The reader count is
+	 incremented with an exclusive store as long as no writer holds the lock or is waiting for it,
+	 otherwise the task waits. Function takes in a pointer to the lock. */
+void OS_rwlock_acquireRead(OS_rwlock_t * lock) {
+	OS_TCB_t const * currentTCB = OS_currentTCB();
+	while (1) {
+		// get and store the current lock notification count
+		uint32_t checkCode = lock->notificationCounter;
+		uint32_t state = __LDREXW (&(lock->state));
+		if (!(state & (_OS_RWLOCK_WRITER | _OS_RWLOCK_WRITER_WAITING))) {
+			if (!(__STREXW (state + 1, &(lock->state)))) {
+				return;
+			}
+		} else {
+			__CLREX();
+			OS_rwlock_wait((uint32_t)lock, checkCode);
+			// the kernel has already counted this task as a reader if it was handed the lock
+			if (currentTCB->waitStatus == TASK_WAIT_HANDOFF) {
+				return;
+			}
+		}
+	}
+}
+
+/* A function that a task can use to release a reader-writer lock that it holds for reading. The last
+	 reader out goes through the kernel if a task is waiting, otherwise the reader count is decremented
+	 with an exclusive store. Function takes in a pointer to the lock. */
+void OS_rwlock_releaseRead(OS_rwlock_t * lock) {
+	while (1) {
+		uint32_t state = __LDREXW (&(lock->state));
+		if ((state & _OS_RWLOCK_READERS) == 1 && (state & _OS_RWLOCK_WAITING)) {
+			__CLREX();
+			OS_rwlock_notify((uint32_t)lock);
+			return;
+		}
+		if (!(__STREXW (state - 1, &(lock->state)))) {
+			return;
+		}
+	}
+}
+
+/* A function that a task can use to acquire a reader-writer lock for writing. The writer bit is set
+	 with an exclusive store if no task holds the lock, otherwise the task waits. Function takes in a
+	 pointer to the lock. */
+void OS_rwlock_acquireWrite(OS_rwlock_t * lock) {
+	OS_TCB_t const * currentTCB = OS_currentTCB();
+	while (1) {
+		// get and store the current lock notification count
+		uint32_t checkCode = lock->notificationCounter;
+		uint32_t state = __LDREXW (&(lock->state));
+		if (!(state & (_OS_RWLOCK_READERS | _OS_RWLOCK_WRITER))) {
+			if (!(__STREXW (state | _OS_RWLOCK_WRITER, &(lock->state)))) {
+				return;
+			}
+		} else {
+			__CLREX();
+			OS_rwlock_wait((uint32_t)lock | _OS_RWLOCK_WAIT_WRITE, checkCode);
+			// the kernel has already set the writer bit for this task if it was handed the lock
+			if (currentTCB->waitStatus == TASK_WAIT_HANDOFF) {
+				return;
+			}
+		}
+	}
+}
+
+/* A function that a task can use to release a reader-writer lock that it holds for writing. If a task
+	 is waiting the release goes through the kernel, otherwise the writer bit is cleared with an
+	 exclusive store. Function takes in a pointer to the lock. */
+void OS_rwlock_releaseWrite(OS_rwlock_t * lock) {
+	while (1) {
+		uint32_t state = __LDREXW (&(lock->state));
+		if (state & _OS_RWLOCK_WAITING) {
+			__CLREX();
+			OS_rwlock_notify((uint32_t)lock);
+			return;
+		}
+		if (!(__STREXW (state & ~_OS_RWLOCK_WRITER, &(lock->state)))) {
+			return;
+		}
+	}
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_rwlock_wait_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that blocks the current task on a reader-writer lock. The task is only
+	 blocked if the check code still matches and the lock is still unavailable to it,
+	 otherwise it returns to retry. The waiting bits are set so that the next release
+	 comes into the kernel to wake it. Function takes in a pointer to the lock, with
+	 bit 0 set for a writer, and the check code. */
+void _OS_rwlock_wait_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_rwlock_t * lock = (OS_rwlock_t *)(stack->r0 & ~_OS_RWLOCK_WAIT_WRITE);
+	uint_fast8_t const writer = stack->r0 & _OS_RWLOCK_WAIT_WRITE;
+	uint32_t checkCode = stack->r1;
+	OS_currentTCB()->waitStatus = TASK_WAIT_NOTIFIED;
+	if (lock->notificationCounter != checkCode) {
+		return;
+	}
+	uint32_t const state = lock->state;
+	if (writer) {
+		if (!(state & (_OS_RWLOCK_READERS | _OS_RWLOCK_WRITER))) {
+			return;
+		}
+		lock->state = state | _OS_RWLOCK_WAITING | _OS_RWLOCK_WRITER_WAITING;
+		_OS_waitqueue_block(&lock->writers);
+	} else {
+		if (!(state & (_OS_RWLOCK_WRITER | _OS_RWLOCK_WRITER_WAITING))) {
+			return;
+		}
+		lock->state = state | _OS_RWLOCK_WAITING;
+		_OS_waitqueue_block(&lock->readers);
+	}
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_rwlock_notify_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that releases a reader-writer lock that has waiting tasks. The
+	 caller's hold is dropped, and if that leaves the lock free it is handed to the
+	 highest priority waiting writer, or to all of the waiting readers if there are
+	 no writers. The waiting bits are then recomputed from what is left in the wait
+	 queues. Function takes in a pointer to the lock. */
+void _OS_rwlock_notify_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_rwlock_t * lock = (OS_rwlock_t *) stack->r0;
+	lock->notificationCounter++;
+	uint32_t state = lock->state;
+	// a task holding the lock for writing is the only holder, otherwise the caller is a reader
+	state = (state & _OS_RWLOCK_WRITER) ? (state & ~_OS_RWLOCK_WRITER) : (state - 1);
+	uint_fast8_t preempt = 0;
+	if (!(state & (_OS_RWLOCK_READERS | _OS_RWLOCK_WRITER))) {
+		OS_TCB_t * task = _OS_waitqueue_pop(&lock->writers);
+		if (task) {
+			state |= _OS_RWLOCK_WRITER;
+			task->waitStatus = TASK_WAIT_HANDOFF;
+			preempt = _OS_wake(task);
+		} else {
+			while ((task = _OS_waitqueue_pop(&lock->readers))) {
+				state++;
+				task->waitStatus = TASK_WAIT_HANDOFF;
+				preempt |= _OS_wake(task);
+			}
+		}
+	}
+	state &= ~(_OS_RWLOCK_WAITING | _OS_RWLOCK_WRITER_WAITING);
+	if (!OS_waitqueue_isEmpty(&lock->writers)) {
+		state |= _OS_RWLOCK_WAITING | _OS_RWLOCK_WRITER_WAITING;
+	} else if (!OS_waitqueue_isEmpty(&lock->readers)) {
+		state |= _OS_RWLOCK_WAITING;
+	}
+	lock->state = state;
+	if (preempt) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
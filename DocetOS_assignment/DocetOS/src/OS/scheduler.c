@@ -3,8 +3,11 @@
 #include "OS/scheduler.h"
 #include "OS/os.h"
 #include "OS/heap.h"
+#include "OS/wheel.h"
 #include "OS/mutex.h"
 #include "OS/semaphore.h"
+#include "OS/waitqueue.h"
+#include "OS/task.h"
 
 #include "stm32f4xx.h"
 #include <string.h>
@@ -17,30 +20,60 @@
 	 advances the head pointer, and returns it.  If the head pointer is null, a pointer to the
 	 idle task is returned instead.
 	 
-	 The scheduler is reasonably efficient but not very flexible.  The "yield" flag is not
-	 checked, but merely cleared before a task is returned, so OS_yield() is equivalent to
-	 OS_schedule() in this implementation. */
+	 The head of each list is the task whose turn it is. The head is only advanced when that task's
+	 time slice has run out or it has yielded, otherwise it keeps running (or resumes, if it was
+	 preempted by a higher priority task). Every task other than the head has a full slice, which is
+	 restored when a task is made ready and when it leaves the head.
+	 
+	 If _OS_SCHEDULER_EDF is set, the per-priority lists are replaced by a single list sorted by
+	 absolute deadline, and the head of that list is always the task that runs. */
 
+#if _OS_SCHEDULER_EDF
+/* A doubly-linked list to contain active tasks, sorted by absolute deadline with the earliest at
+	 the head. Tasks with equal deadlines are kept in the order they were made ready. */
+static _OS_tasklist_t _edf_list = {.head = 0};
+#else
 /* An array of doubly-linked lists to contain active tasks in each priority levels for scheduler.
 	 This is a circular buffer of tasks for the round-robin scheduler. */
 static _OS_tasklist_t _task_list[_OS_PRIORITY_LEVELS];
 
+/* Two-level bitmap of the priority levels that currently have at least one ready task.
+
+	 Each word of _ready_bitmap covers 32 priority levels, and each bit of _ready_group flags a non-zero
+	 word of _ready_bitmap. Bits are stored MSB-first (level 0 is bit 31) so that a single CLZ on a word
+	 directly yields the index of the highest priority set bit. Finding the highest ready level is then
+	 two CLZ instructions regardless of the number of priority levels (up to 32 * 32, although the TCB
+	 priority field limits this to 256). */
+#define _OS_READY_WORDS ((_OS_PRIORITY_LEVELS + 31) / 32)
+static uint32_t _ready_group = 0;
+static uint32_t _ready_bitmap[_OS_READY_WORDS];
+#endif /* _OS_SCHEDULER_EDF */
+
 /* Singly-linked lists to contain pending tasks. */
 _OS_tasklist_t pending_list = {.head = 0};
 
-/* A generic heap is implemented to hold the list of sleeping tasks. 
+/* A hierarchical timing wheel is implemented to hold the sleeping tasks. 
+
+	 The wheel is keyed on the 64-bit wake time in the TCB's wakeTime field, and links the tasks through the
+	 TCB's intrusive timer fields, so sleeping is O(1) and there is no limit on the number of sleeping
+	 tasks. See wheel.c for details. */
+static OS_wheel_t _sleeping_wheel = OS_WHEEL_INITIALISER;
+
+/* A SL list of pooled tasks that have exited and are waiting for their memory to be freed. It
+	 is only touched by the exit delegate and the scheduler, which can't preempt each other. */
+static _OS_tasklist_t _zombie_list = {.head = 0};
 
-	 Since this is a generic heap, a use-case-specialised comparator function must be present. In
-	 this case, the function compares the wake time in the TCB's data field. */
-static int_fast8_t heapComparator (void * task1, void * task2) {
-	uint32_t wakeTime1 = ((OS_TCB_t*)task1)->data;
-	uint32_t wakeTime2 = ((OS_TCB_t*)task2)->data;
-	return (int_fast8_t)(wakeTime1 - wakeTime2);
+/* The tick at which the SysTick handler next needs to pend PendSV to wake a sleeping task. It
+	 starts at zero so that the first tick always runs the scheduler. */
+uint32_t volatile _OS_nextWakeTick = 0;
+
+/* Internal function to record when the sleeping wheel next needs advancing. The distance is
+	 clamped so that the SysTick handler's wrapping comparison stays valid, at the cost of one
+	 spurious scheduler pass for a task that sleeps for longer than 2^31 ticks. */
+static void _update_next_wake(uint32_t const expiry) {
+	uint32_t const distance = (expiry > INT32_MAX) ? INT32_MAX : expiry;
+	_OS_nextWakeTick = (uint32_t)_sleeping_wheel.time + distance;
 }
-/* A memory store is initialised, with a size predefined in the scheduler header file, and the
-	 heap itself is initialised using the store and comparator function. */
-static void *heapStore[_OS_SLEEPINGHEAP_SIZE];
-static OS_heap_t _sleeping_heap = OS_HEAP_INITIALISER(heapStore, heapComparator);
 
 /* A function to add a task to the start of a doubly linked list whilst preserving the head,
 	 used in the scheduler's round-robin task list. Function takes in the pointer to the list
@@ -87,6 +120,155 @@ static void _list_remove(_OS_tasklist_t * list, OS_TCB_t * task) {
 	task->prev->next = task->next;
 }
 
+#if _OS_SCHEDULER_EDF
+/* Function to add a task to the scheduler's deadline-sorted DL task list, after every task with
+	 the same or an earlier absolute deadline. Takes in the pointer to the task to add. */
+static void _ready_add(OS_TCB_t * task) {
+	OS_TCB_t * const head = _edf_list.head;
+	// a task is always made ready with a full time slice
+	task->sliceRemaining = task->timeSlice;
+	task->state |= TASK_STATE_READY;
+	// an empty list, or a deadline no earlier than the tail's, means the task goes on the end
+	if (!head || task->absoluteDeadline >= head->prev->absoluteDeadline) {
+		_list_add(&_edf_list, task);
+		return;
+	}
+	// find the first task with a later deadline, there must be one since the tail's is later
+	OS_TCB_t * later = head;
+	while (later->absoluteDeadline <= task->absoluteDeadline) {
+		later = later->next;
+	}
+	// link the new task in before it
+	task->next = later;
+	task->prev = later->prev;
+	later->prev->next = task;
+	later->prev = task;
+	// the new task becomes the head if it has the earliest deadline
+	if (later == head) {
+		_edf_list.head = task;
+	}
+}
+
+/* Function to remove a task from the scheduler's deadline-sorted DL task list. Takes in the
+	 pointer to the task to remove. */
+static void _ready_remove(OS_TCB_t * task) {
+	_list_remove(&_edf_list, task);
+	task->state &= ~TASK_STATE_READY;
+}
+
+/* Function to pick the next task to run, which is the one with the earliest deadline at the head
+	 of the list. A task that has yielded or used up its time slice is moved behind any other tasks
+	 with the same deadline first. A running task that holds a ceiling mutex is kept regardless, and
+	 flagged if that defers an earlier deadline. Returns NULL if no task is ready. */
+static OS_TCB_t * _ready_next(void) {
+	OS_TCB_t * const current = _currentTCB;
+	current->state &= ~TASK_STATE_DEFERRED;
+	if (current->ceiling < _OS_PRIORITY_LEVELS
+			&& (current->state & (TASK_STATE_READY | TASK_STATE_YIELD)) == TASK_STATE_READY) {
+		if (_edf_list.head != current) {
+			current->state |= TASK_STATE_DEFERRED;
+		}
+		return current;
+	}
+	OS_TCB_t * task = _edf_list.head;
+	if (task && ((task->state & TASK_STATE_YIELD) || !task->sliceRemaining)) {
+		// re-adding the task gives it a full slice
+		_ready_remove(task);
+		_ready_add(task);
+		task = _edf_list.head;
+	}
+	return task;
+}
+#else
+/* Function to add a task to the scheduler's DL task list for its priority level, and to flag
+	 that priority level as ready in the bitmap. Takes in the pointer to the task to add. */
+static void _ready_add(OS_TCB_t * task) {
+	uint_fast8_t const priority = task->priority;
+	// a task is always made ready with a full time slice
+	task->sliceRemaining = task->timeSlice;
+	task->state |= TASK_STATE_READY;
+	_list_add(&_task_list[priority], task);
+	// set the level bit and the bit of the word that contains it
+	_ready_bitmap[priority >> 5] |= (1UL << 31) >> (priority & 31);
+	_ready_group |= (1UL << 31) >> (priority >> 5);
+}
+
+/* Function to remove a task from the scheduler's DL task list for its priority level. If the
+	 list becomes empty, the priority level is cleared from the bitmap. Takes in the pointer to
+	 the task to remove. */
+static void _ready_remove(OS_TCB_t * task) {
+	uint_fast8_t const priority = task->priority;
+	_list_remove(&_task_list[priority], task);
+	task->state &= ~TASK_STATE_READY;
+	if (!_task_list[priority].head) {
+		// level is empty, clear its bit, and clear the group bit if the whole word is now empty
+		_ready_bitmap[priority >> 5] &= ~((1UL << 31) >> (priority & 31));
+		if (!_ready_bitmap[priority >> 5]) {
+			_ready_group &= ~((1UL << 31) >> (priority >> 5));
+		}
+	}
+}
+
+/* Function to find the highest priority (numerically smallest) level that contains a ready task
+	 using two CLZ instructions on the ready bitmap. Returns _OS_PRIORITY_LEVELS if no task is ready. */
+static uint_fast16_t _ready_highest(void) {
+	if (!_ready_group) {
+		return _OS_PRIORITY_LEVELS;
+	}
+	uint32_t const word = __CLZ(_ready_group);
+	return (word << 5) + __CLZ(_ready_bitmap[word]);
+}
+
+/* Function to find the priority level that a task has to be above to preempt the given one. This
+	 is the highest of its priority (which mutex inheritance may have raised), its preemption
+	 threshold, and the ceiling of any ceiling mutex that it holds. */
+static uint_fast16_t _preemption_level(OS_TCB_t const * task) {
+	uint_fast16_t const level = (task->priority < task->preemptionThreshold) ? task->priority : task->preemptionThreshold;
+	return (task->ceiling < level) ? task->ceiling : level;
+}
+
+/* Function to pick the next task to run from the DL task list of the highest ready priority
+	 level. The list is only rotated if the task at its head has used up its time slice or has
+	 yielded. The running task is kept if it is still ready, hasn't yielded, has slice left (or
+	 holds a ceiling mutex, which stops rotation) and nothing is ready above its preemption level.
+	 If that holds off a higher priority task, the running task is flagged so that it reschedules
+	 as soon as it lowers its level. Returns NULL if no task is ready. */
+static OS_TCB_t * _ready_next(void) {
+	// find the highest priority level that has a scheduled task
+	uint_fast16_t const i = _ready_highest();
+	OS_TCB_t * const current = _currentTCB;
+	current->state &= ~TASK_STATE_DEFERRED;
+	if ((current->state & (TASK_STATE_READY | TASK_STATE_YIELD)) == TASK_STATE_READY
+			&& (current->sliceRemaining || current->ceiling < _OS_PRIORITY_LEVELS)
+			&& i >= _preemption_level(current)) {
+		if (i < current->priority) {
+			current->state |= TASK_STATE_DEFERRED;
+		}
+		return current;
+	}
+	// check if there are any scheduled tasks at all
+	if (i < _OS_PRIORITY_LEVELS) {
+		OS_TCB_t * head = _task_list[i].head;
+		if (!head->sliceRemaining || (head->state & TASK_STATE_YIELD)) {
+			// the task leaving the head gets a full slice for its next turn
+			head->sliceRemaining = head->timeSlice;
+			// move the head over by one in the scheduler
+			head = head->next;
+			_task_list[i].head = head;
+		}
+		return head;
+	}
+	return 0;
+}
+#endif /* _OS_SCHEDULER_EDF */
+
+/* Function to work out the absolute deadline of a task's current job from its release time,
+	 ignoring any deadline inherited through a mutex. A task with no relative deadline has no
+	 deadline, which is represented by the latest possible time. */
+static uint64_t _own_deadline(OS_TCB_t const * task) {
+	return task->relativeDeadline ? (task->release + task->relativeDeadline) : UINT64_MAX;
+}
+
 /* Function to push an item into the head of a singly-linked (sl) list. Takes in a pointer
 	 to the SL list and the pointer to the task to insert as arguments. */
 void list_push_sl(_OS_tasklist_t * list, OS_TCB_t * task) {
@@ -183,39 +365,122 @@ OS_TCB_t * list_pop_tail_sl(_OS_tasklist_t * list) {
 	return current;
 }
 
+/* Function to detach every item from a singly-linked (sl) list at once. Takes in a pointer to
+	 the list as the only argument. The head is swapped for NULL in a single exclusive access, so
+	 producers pushing with list_push_sl() are never held up by the consumer, and the consumer
+	 doesn't retry per item. Pushes go to the head, so the detached chain is reversed before it is
+	 returned, giving the items in the order they were pushed. Returns NULL if the list is empty. */
+OS_TCB_t * list_take_all_sl(_OS_tasklist_t * list) {
+	OS_TCB_t * chain = NULL;
+	do {
+		chain = (OS_TCB_t *) __LDREXW ((uint32_t volatile *)&(list->head));
+		if (!chain) {
+			__CLREX();
+			return NULL;
+		}
+	} while (__STREXW (0, (uint32_t volatile *)&(list->head)));
+	// the chain is now private to the caller, so it can be reversed without exclusive accesses
+	OS_TCB_t * fifo = NULL;
+	while (chain) {
+		OS_TCB_t * const next = chain->next;
+		chain->next = fifo;
+		fifo = chain;
+		chain = next;
+	}
+	return fifo;
+}
+
+/* Function to free the memory of every exited pooled task, except the current task. That one
+	 has only just exited, and its stack will still be used to save its context when it is
+	 switched away from, so it is left for a later pass. */
+static void _reclaim_zombies(void) {
+	OS_TCB_t ** link = &_zombie_list.head;
+	while (*link) {
+		OS_TCB_t * const task = *link;
+		if (task == _currentTCB) {
+			link = &task->next;
+		} else {
+			*link = task->next;
+			_OS_task_free(task);
+		}
+	}
+}
+
 /* Round-robin scheduler. First wakes any sleeping tasks that needs waking, next, moves
-	 all pending tasks to the scheduler DL task list, finally, iterates through each
-	 priority-specific DL task list element in the array of task lists. A task is scheduled
-	 by returning the correct TCB from this function, if there are no tasks that can be
-	 scheduled, the idle task is returned. */
+	 all pending tasks to the scheduler DL task list, finally, looks up the highest ready
+	 priority level in the ready bitmap and rotates that level's DL task list. A task is
+	 scheduled by returning the correct TCB from this function, if there are no tasks that
+	 can be scheduled, the idle task is returned. */
 OS_TCB_t const * _OS_schedule(void) {
-	// check if there are any sleeping tasks and check if any needs to be awakened
-	while (!OS_heap_isEmpty(&_sleeping_heap) && ((OS_TCB_t *)_sleeping_heap.heapStore[0])->data <= OS_elapsedTicks()) {
-		OS_TCB_t *taskToWake = OS_heap_extract(&_sleeping_heap);
-		_list_add(&_task_list[taskToWake->priority], taskToWake);
-	}
-	// remove all pending tasks until that list is empty and place them into the round-robin
-	while (pending_list.head) {
-		/* Since task_list is doubly-linked, we use list add, pending_list is popped with the
-			 singly-linked (sl) pop function. */
-		OS_TCB_t *taskToRun = list_pop_head_sl(&pending_list);
-		_list_add(&_task_list[taskToRun->priority], taskToRun);
-	}
-	// iterate for each priority level
-	for (uint_fast8_t i = 0; i < _OS_PRIORITY_LEVELS; i++) {
-		// check if there are any scheduled tasks for this priority level
-		if (_task_list[i].head) {
-			// move the head over by one in the scheduler
-			_task_list[i].head = _task_list[i].head->next;
-			// task can be returned, reset sleep flag if set to 1, and reset yield flag
-			_task_list[i].head->state &= ~(TASK_STATE_SLEEP | TASK_STATE_YIELD);
-			// return the task
-			return _task_list[i].head;
+	_reclaim_zombies();
+#if _OS_TICKLESS_IDLE
+	// bring the tick count up to date if the idle task was woken early from a stretched tick
+	_OS_tickless_exit();
+#endif
+	// advance the sleeping wheel to the current time and wake every task that has expired
+	OS_TCB_t *taskToWake = OS_wheel_expire(&_sleeping_wheel, OS_elapsedTicks64());
+	while (taskToWake) {
+		// cache the next expired task, since adding to the task list doesn't touch the timer links
+		OS_TCB_t *nextToWake = taskToWake->timerNext;
+		if (taskToWake->waitCancel) {
+			/* A timed wait has run out. ISRs can wake the task from the object it is waiting on, so
+				 it is taken out of the object with interrupts disabled, unless it has already been
+				 woken, in which case it is in the pending list and is made ready from there. */
+			__disable_irq();
+			uint_fast8_t const timedOut = taskToWake->waitCancel(taskToWake);
+			__enable_irq();
+			taskToWake->waitCancel = 0;
+			if (timedOut) {
+				taskToWake->waitStatus = TASK_WAIT_TIMEOUT;
+				_ready_add(taskToWake);
+			}
+		} else {
+			// waking from a sleep releases a new job, which gets a new deadline
+			taskToWake->release = taskToWake->wakeTime;
+			taskToWake->absoluteDeadline = _own_deadline(taskToWake);
+			_ready_add(taskToWake);
 		}
+		taskToWake = nextToWake;
 	}
-	/* If all priority levels have been iterated through and no task is scheduled, then we
-	   return the idle task. */
-	return _OS_idleTCB_p;
+	/* Take the whole pending list in one go and place the tasks into the ready lists in the order
+		 they were made ready. _ready_add() relinks the task's list pointers, so the next pending
+		 task is cached first. */
+	OS_TCB_t *taskToRun = list_take_all_sl(&pending_list);
+	while (taskToRun) {
+		OS_TCB_t *nextToRun = taskToRun->next;
+		// a task woken from a timed wait before the timeout no longer needs its timer
+		if (taskToRun->waitCancel) {
+			taskToRun->waitCancel = 0;
+			if (taskToRun->timerPrev) {
+				OS_wheel_remove(&_sleeping_wheel, taskToRun);
+			}
+		}
+		_ready_add(taskToRun);
+		taskToRun = nextToRun;
+	}
+	uint32_t const expiry = OS_wheel_nextExpiry(&_sleeping_wheel);
+	_update_next_wake(expiry);
+	_OS_stats.schedulerPasses++;
+	// pick the next task according to the scheduling policy
+	OS_TCB_t * const task = _ready_next();
+	OS_TCB_t const * next = task;
+	// check if there are any scheduled tasks at all
+	if (task) {
+		// task can be returned, reset sleep flag if set to 1, and reset yield flag
+		task->state &= ~(TASK_STATE_SLEEP | TASK_STATE_YIELD);
+	} else {
+		/* If no task is scheduled, then we return the idle task. */
+#if _OS_TICKLESS_IDLE
+		/* Nothing can run until a sleeping task wakes or an interrupt makes a task ready, so the
+			 SysTick period is stretched up to the next event in the sleeping wheel. */
+		_OS_tickless_enter(expiry);
+#endif
+		next = _OS_idleTCB_p;
+	}
+	if (next != _currentTCB) {
+		_OS_stats.contextSwitches++;
+	}
+	return next;
 }
 
 /* Initialises a task control block (TCB) and its associated stack.  See os.h for details. */
@@ -223,6 +488,17 @@ void OS_initialiseTCB(OS_TCB_t * TCB, uint32_t * const stack, void (* const func
 	TCB->sp = stack - (sizeof(_OS_StackFrame_t) / sizeof(uint32_t));
 	TCB->state = 0;
 	TCB->prev = TCB->next = 0;
+	TCB->timerNext = 0;
+	TCB->timerPrev = 0;
+	TCB->pool = 0;
+	TCB->heldMutexes = 0;
+	TCB->blockedOn = 0;
+	TCB->eventFlags = 0;
+	TCB->eventOptions = 0;
+	TCB->waitBuffer = 0;
+	TCB->waitObject = 0;
+	TCB->waitCancel = 0;
+	TCB->waitQueue = 0;
 	// check if priority has been passed and if it's a valid number
 	if (!priority || (priority > _OS_PRIORITY_LEVELS)) {
 		// if it's invalid, assign the lowest priority (highest number)
@@ -233,6 +509,18 @@ void OS_initialiseTCB(OS_TCB_t * TCB, uint32_t * const stack, void (* const func
 	}
 	// initialise to ensure priority level is restored after inheritance promotion
 	TCB->originalPriority = TCB->priority;
+	// by default a task can be preempted by any task of a higher priority
+	TCB->preemptionThreshold = TCB->priority;
+	TCB->ceiling = _OS_PRIORITY_LEVELS;
+	// by default a task has no deadline, see OS_setDeadline()
+	TCB->relativeDeadline = 0;
+	TCB->period = 0;
+	TCB->release = 0;
+	TCB->absoluteDeadline = UINT64_MAX;
+	TCB->deadlineMisses = 0;
+	TCB->timeSlice = _OS_TIMESLICE_DEFAULT;
+	TCB->sliceRemaining = _OS_TIMESLICE_DEFAULT;
+	TCB->waitStatus = TASK_WAIT_NOTIFIED;
 	_OS_StackFrame_t *sf = (_OS_StackFrame_t *)(TCB->sp);
 	/* By placing the address of the task function in pc, and the address of _OS_task_end() in lr, the task
 	   function will be executed on the first context switch, and if it ever exits, _OS_task_end() will be
@@ -260,27 +548,198 @@ void OS_initialiseTCB(OS_TCB_t * TCB, uint32_t * const stack, void (* const func
 /* Function that adds a task TCB to the correct array element (based on TCB's priority field)
 	 of the DL task list array. */
 void OS_addTask(OS_TCB_t * const tcb) {
-	_list_add(&_task_list[tcb->priority], tcb);
+	_ready_add(tcb);
+}
+
+/* Function that sets the relative deadline and period of a task, and releases its first job
+	 at the current time. See scheduler.h for details. */
+void OS_setDeadline(OS_TCB_t * const tcb, uint32_t const relativeDeadline, uint32_t const period) {
+	tcb->relativeDeadline = relativeDeadline;
+	tcb->period = period;
+	tcb->release = OS_elapsedTicks64();
+	tcb->absoluteDeadline = _own_deadline(tcb);
+}
+
+/* Function that sets the round-robin time slice of a task. See scheduler.h for details. */
+void OS_setTimeSlice(OS_TCB_t * const tcb, uint32_t const ticks) {
+	tcb->timeSlice = ticks;
+	tcb->sliceRemaining = ticks;
+}
+
+/* Function that sets the preemption threshold of a task. See scheduler.h for details. */
+void OS_setPreemptionThreshold(OS_TCB_t * const tcb, uint_fast8_t const threshold) {
+	// a threshold that is invalid or below the task's own priority is ignored
+	if (threshold && (threshold - 1u) < tcb->originalPriority) {
+		tcb->preemptionThreshold = threshold - 1;
+	}
 }
 
 /* SVC handler that's called by _OS_task_end when a task finishes.  Removes the
-   task from the scheduler and then queues PendSV to reschedule. */
+   task from the scheduler and then queues PendSV to reschedule. A task created
+   by OS_createTask() is put on the zombie list so that its memory is freed. */
 void _OS_taskExit_delegate(void) {
 	// Remove the given TCB from the list of tasks so it won't be run again
 	OS_TCB_t * tcb = OS_currentTCB();
-	_list_remove(&_task_list[tcb->priority], tcb);
+	_ready_remove(tcb);
+	if (tcb->pool) {
+		tcb->next = _zombie_list.head;
+		_zombie_list.head = tcb;
+	}
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/* Function to block the current task. The task is taken out of the ready lists and PendSV is set
+	 so that another task is switched to. Used by the delegates of blocking objects built on wait
+	 queues, which keep the task themselves until it is woken with _OS_wake(). */
+void _OS_block(void) {
+	_ready_remove(OS_currentTCB());
 	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
+/* Function to block the current task with a timeout. The task is blocked as with _OS_block(),
+	 and unless it waits forever, it is also put in the sleeping wheel to expire after the timeout.
+	 The expiry is handled by the scheduler using the cancel function (see scheduler.h). Unlike a
+	 sleep, the sleep flag isn't set, and the expiry doesn't release a new job of the task. Function
+	 takes in the timeout in ticks and the cancel function. */
+void _OS_block_timeout(uint32_t timeout, uint_fast8_t (* cancel)(OS_TCB_t * task)) {
+	OS_TCB_t * currentTask = OS_currentTCB();
+	_OS_block();
+	if (timeout != OS_WAIT_FOREVER) {
+		currentTask->waitCancel = cancel;
+		currentTask->wakeTime = OS_elapsedTicks64() + timeout;
+		OS_wheel_insert(&_sleeping_wheel, currentTask);
+	}
+}
+
+/* Function to convert a timeout to the absolute tick at which it runs out. Function takes in the
+	 timeout in ticks. Returns the tick, or UINT64_MAX if the timeout is OS_WAIT_FOREVER. */
+uint64_t _OS_timeout_deadline(uint32_t timeout) {
+	if (timeout == OS_WAIT_FOREVER) {
+		return UINT64_MAX;
+	}
+	return OS_elapsedTicks64() + timeout;
+}
+
+/* Function to find how much of a timeout is left. Function takes in the deadline from
+	 _OS_timeout_deadline(). Returns the ticks left, 0 if the deadline has passed, or
+	 OS_WAIT_FOREVER if there is no deadline. */
+uint32_t _OS_timeout_remaining(uint64_t deadline) {
+	if (deadline == UINT64_MAX) {
+		return OS_WAIT_FOREVER;
+	}
+	uint64_t const now = OS_elapsedTicks64();
+	return (now >= deadline) ? 0 : (uint32_t)(deadline - now);
+}
+
+/* Mutex inheritance works on a task's rank, which is its priority, or its absolute deadline
+	 under EDF. In both cases a smaller value ranks higher. */
+#if _OS_SCHEDULER_EDF
+typedef uint64_t _rank_t;
+#define _RANK(task) ((task)->absoluteDeadline)
+#define _OWN_RANK(task) _own_deadline(task)
+#else
+typedef uint_fast8_t _rank_t;
+#define _RANK(task) ((task)->priority)
+#define _OWN_RANK(task) ((task)->originalPriority)
+#endif
+
+/* Function to change the rank of a task wherever it is. A ready task is taken out of the ready
+	 lists and put on the pending list, so that the scheduler re-adds it at its new rank. A task
+	 waiting on a mutex is re-sorted in that mutex's waiting heap, and a task in a wait queue is
+	 re-sorted in the queue, with interrupts disabled since ISRs can take tasks out of some wait
+	 queues. A task that is sleeping, waiting on a semaphore or event flags, or already pending
+	 just has the field changed. */
+static void _set_rank(OS_TCB_t * task, _rank_t rank) {
+	if (task->state & TASK_STATE_READY) {
+		_ready_remove(task);
+		_RANK(task) = rank;
+		list_push_sl(&pending_list, task);
+	} else if (task->blockedOn) {
+		OS_heap_remove(&task->blockedOn->waiting_heap, task);
+		_RANK(task) = rank;
+		OS_heap_insert(&task->blockedOn->waiting_heap, task);
+	} else if (task->waitQueue) {
+		// this may already run with interrupts disabled, from a cancel function
+		uint32_t const primask = __get_PRIMASK();
+		__disable_irq();
+		OS_waitqueue_t * const queue = task->waitQueue;
+		if (queue) {
+			_OS_waitqueue_remove(queue, task);
+			_RANK(task) = rank;
+			_OS_waitqueue_insert(queue, task);
+		} else {
+			_RANK(task) = rank;
+		}
+		__set_PRIMASK(primask);
+	} else {
+		_RANK(task) = rank;
+	}
+}
+
+/* Function to make a blocked task ready again. The task is pushed onto the pending list, which
+	 is safe from any context, and the scheduler places it into the ready lists on its next pass.
+	 The task only preempts the running one if it has a strictly higher priority than the running
+	 task's preemption level (or an earlier deadline under EDF, unless the running task holds a
+	 ceiling mutex), otherwise it waits until the running task's slice runs out. If it outranks the
+	 running task but is held off, the running task is flagged as having a deferred preemption.
+	 Function takes in a pointer to the task to wake. Returns 1 if the task should preempt. */
+uint_fast8_t _OS_wake(OS_TCB_t * task) {
+	list_push_sl(&pending_list, task);
+	OS_TCB_t * const current = _currentTCB;
+	// anything preempts the idle task
+	if (current == _OS_idleTCB_p) {
+		return 1;
+	}
+#if _OS_SCHEDULER_EDF
+	uint_fast8_t const outranks = task->absoluteDeadline < current->absoluteDeadline;
+	uint_fast8_t const preempts = outranks && current->ceiling >= _OS_PRIORITY_LEVELS;
+#else
+	uint_fast8_t const outranks = task->priority < current->priority;
+	uint_fast8_t const preempts = task->priority < _preemption_level(current);
+#endif
+	if (outranks && !preempts) {
+		current->state |= TASK_STATE_DEFERRED;
+	}
+	return preempts;
+}
+
 /* Since delegate functions are branched to and not directly accessed via C
    function calls, the prototype does not need to be in the header file, they
    can be placed right above the function for readability. */
 void _OS_mutex_wait_delegate(_OS_SVC_StackFrame_t * stack);
+
+/* Function to take a task whose timeout has run out out of the waiting heap of the
+	 mutex it is blocked on, called by the scheduler with interrupts disabled. If no
+	 task is left waiting, the contended flag is cleared so that the owner's release
+	 takes the fast path, and the owner's inherited priority is recomputed without
+	 the task. The wait delegate may have passed the promotion on along the chain of
+	 holders blocked on further mutexes, so the recomputation follows the same chain,
+	 stopping at the first holder whose priority doesn't change, since nothing past
+	 it can have changed either. Function takes in the task. Returns 0 if the task
+	 had already been taken out of the heap to be woken, otherwise 1. */
+static uint_fast8_t _mutex_cancel(OS_TCB_t * task) {
+	OS_mutex_t * mutex = task->waitObject;
+	if (!OS_heap_remove(&mutex->waiting_heap, task)) {
+		return 0;
+	}
+	task->blockedOn = 0;
+	if (OS_heap_isEmpty(&mutex->waiting_heap)) {
+		mutex->owner &= ~_OS_MUTEX_CONTENDED;
+	}
+	OS_TCB_t * holder = _OS_mutex_owner(mutex);
+	while (holder && _OS_inheritance_restore(holder)) {
+		holder = holder->blockedOn ? _OS_mutex_owner(holder->blockedOn) : 0;
+	}
+	return 1;
+}
+
 /* SVC handler that removes the current task from the round robin and inserts it
 	 into the priority level sorted mutex-specific heap. If the mutex-holding task
 	 has a lower priority than the task entering the waiting list, the mutex-holder
-	 gains a priority level promotion to ensure speedy release. This delegate function
-	 takes in a pointer to a mutex and the check code as arguments. */
+	 gains a priority level promotion to ensure speedy release. If the holder is
+	 itself waiting for another mutex, the promotion is passed on to that mutex's
+	 holder, and so on along the chain. This delegate function takes in a pointer
+	 to a mutex, the check code and the timeout in ticks as arguments. */
 void _OS_mutex_wait_delegate(_OS_SVC_StackFrame_t * stack) {
 	// get the mutex that the task needs to wait for
 	OS_mutex_t * mutex = (OS_mutex_t *) stack->r0;
@@ -291,28 +750,35 @@ void _OS_mutex_wait_delegate(_OS_SVC_StackFrame_t * stack) {
 	   if the check code differs from the global notification counter, then it
 	   means that the notify function was called, and thus the wait cannot happen
 	   since the lists differ. */
+	OS_currentTCB()->waitStatus = TASK_WAIT_NOTIFIED;
 	if (mutex->notificationCounter == checkCode) {
+		// if the mutex has been released since the check, return to retry the acquisition
+		uint32_t const owner = mutex->owner;
+		if (!(owner & ~_OS_MUTEX_CONTENDED)) {
+			return;
+		}
+		/* Flag the mutex as contended so that the owner's release takes the slow path and wakes
+			 this task. An exclusive access in progress in the owner is broken by this exception,
+			 so it will see the flag when it retries. */
+		mutex->owner = owner | _OS_MUTEX_CONTENDED;
 		// get the current task and cache it
 		OS_TCB_t * currentTask = OS_currentTCB();
-		// get the mutex-holding task and cache it
-		OS_TCB_t * mutexTask = mutex->task;
-		// remove this task from the round robin
-		_list_remove(&_task_list[currentTask->priority], currentTask);
+		// remove this task from the round robin, setting its timeout if it has one
+		currentTask->waitObject = mutex;
+		_OS_block_timeout(stack->r2, _mutex_cancel);
 		// add the current task to the mutex wait heap
+		currentTask->blockedOn = mutex;
 		OS_heap_insert(&mutex->waiting_heap, currentTask);
-		/* Priority inheritance logic: promote mutex-holder if requesting task is
-			 of higher priority. Remembering that higher priority = smaller priority
-			 numbers. */
-		if (mutexTask->priority > currentTask->priority) {
-			// remove mutex-holder from task list
-			_list_remove(&_task_list[mutexTask->priority], mutexTask);
-			// promote the priority of the mutex-holder
-			mutexTask->priority = currentTask->priority;
-			// add the mutex-holder to the pending list for scheduler to sweep and schedule
-			list_push_sl(&pending_list, mutexTask);
+		/* Transitive inheritance logic: promote the mutex-holder if the requesting task
+			 ranks above it, then follow the mutex that the holder is blocked on, if any. The
+			 walk stops at the first holder that already ranks as high, which also stops it
+			 going round a deadlocked cycle forever. A mutex further along the chain may have
+			 been released, in which case the walk stops there. */
+		OS_TCB_t * holder = _OS_mutex_owner(mutex);
+		while (holder && _RANK(holder) > _RANK(currentTask)) {
+			_set_rank(holder, _RANK(currentTask));
+			holder = holder->blockedOn ? _OS_mutex_owner(holder->blockedOn) : 0;
 		}
-		// set PendSV bit to invoke context switch
-		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	}
 }
 
@@ -320,9 +786,26 @@ void _OS_mutex_wait_delegate(_OS_SVC_StackFrame_t * stack) {
    function calls, the prototype does not need to be in the header file, they
    can be placed right above the function for readability. */
 void _OS_semaphore_wait_delegate(_OS_SVC_StackFrame_t * stack);
+
+/* Function to take a task whose timeout has run out out of the waiting list of the
+	 semaphore it is blocked on, called by the scheduler with interrupts disabled. A
+	 release that was popping from the list when the scheduler ran will fail its
+	 exclusive store and retry. Function takes in the task. Returns 0 if the task had
+	 already been taken out of the list to be woken, otherwise 1. */
+static uint_fast8_t _semaphore_cancel(OS_TCB_t * task) {
+	OS_semaphore_t * semaphore = task->waitObject;
+	for (OS_TCB_t ** link = &semaphore->waiting_list.head; *link; link = &(*link)->next) {
+		if (*link == task) {
+			*link = task->next;
+			return 1;
+		}
+	}
+	return 0;
+}
+
 /* SVC handler that removes the current task from the round robin and adds to the
 	 semaphore-specific singly-linked waiting list. Function takes in pointer to a
-	 semaphore and a check code as arguments. */
+	 semaphore, a check code and the timeout in ticks as arguments. */
 void _OS_semaphore_wait_delegate(_OS_SVC_StackFrame_t * stack) {
 	// get the semaphore that the task needs to wait for
 	OS_semaphore_t * semaphore = (OS_semaphore_t *) stack->r0;
@@ -333,18 +816,35 @@ void _OS_semaphore_wait_delegate(_OS_SVC_StackFrame_t * stack) {
 	   if the check code differs from the global notification counter, then it
 	   means that the notify function was called, and thus the wait cannot happen
 	   since the lists differ. */
+	OS_currentTCB()->waitStatus = TASK_WAIT_NOTIFIED;
 	if (semaphore->notificationCounter == checkCode) {
 		// get the current task and cache it
 		OS_TCB_t * currentTask = OS_currentTCB();
-		// remove this task from the round robin
-		_list_remove(&_task_list[currentTask->priority], currentTask);
+		// remove this task from the round robin, setting its timeout if it has one
+		currentTask->waitObject = semaphore;
+		_OS_block_timeout(stack->r2, _semaphore_cancel);
 		// add the current task to the semaphore wait heap
 		list_push_sl(&semaphore->waiting_list, currentTask);
-		// set PendSV bit to invoke context switch
-		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	}
 }
 
+/* Function to put the current task to sleep until the given absolute tick, shared
+	 by the sleep delegates. Function takes in the 64-bit wake time. */
+static void _sleep_until(uint64_t wakeTime) {
+	// The running task's TCB is retrieved and stored
+	OS_TCB_t * currentTask = OS_currentTCB();
+	// wakeTime can be stored in TCB in the wakeTime field
+	currentTask->wakeTime = wakeTime;
+	// Set the TCB state to sleeping
+	currentTask->state |= TASK_STATE_SLEEP;
+	// Remove the sleeping task from the scheduler's task list
+	_ready_remove(currentTask);
+	// Place the just removed task into the sleeping wheel
+	OS_wheel_insert(&_sleeping_wheel, currentTask);
+	// Call PendSV to invoke _OS_scheduler to start the next task
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
 /* Since delegate functions are branched to and not directly accessed via C
    function calls, the prototype does not need to be in the header file, they
    can be placed right above the function for readability. */
@@ -354,39 +854,82 @@ void OS_sleep_delegate(_OS_SVC_StackFrame_t * stack);
 void OS_sleep_delegate(_OS_SVC_StackFrame_t * stack) {
 	// Get the sleep duration that's been passed in
 	uint32_t sleepDuration = stack->r0;
-	// The running task's TCB is retrieved and stored
-	OS_TCB_t * currentTask = OS_currentTCB();
 	// wakeTime time is calculated by adding sleepDuration to the elapsed OS ticks
-	uint32_t wakeTime = OS_elapsedTicks() + sleepDuration;
-	// wakeTime can be stored in TCB in the data field
-	currentTask->data = wakeTime;
-	// Set the TCB state to sleeping
-	currentTask->state |= TASK_STATE_SLEEP;
-	// Remove the sleeping task from the scheduler's task list
-	_list_remove(&_task_list[currentTask->priority], currentTask);
-	// Place the just removed task into the heap
-	OS_heap_insert(&_sleeping_heap, currentTask);
-	// Call PendSV to invoke _OS_scheduler to start the next task
-	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	_sleep_until(OS_elapsedTicks64() + sleepDuration);
 }
 
 /* Since delegate functions are branched to and not directly accessed via C
    function calls, the prototype does not need to be in the header file, they
    can be placed right above the function for readability. */
-void _OS_priorityRestore_delegate(_OS_SVC_StackFrame_t * stack);
-/* Function to restore a task's original priority level after a temporary
-	 priority promotion from the mutex inheritance implementation. Function
-	 takes in the pointer to a TCB as an argument. */
-void _OS_priorityRestore_delegate(_OS_SVC_StackFrame_t * stack) {
-	// get the TCB that needs it's priority restored from the stack
-	OS_TCB_t * task = (OS_TCB_t *) stack->r0;
-	// check if task needs priority restoration
-	if (task->priority != task->originalPriority){
-		// remove the task from scheduler task list
-		_list_remove(&_task_list[task->priority], task);
-		// restore the task's original priority
-		task->priority = task->originalPriority;
-		// add the task to the pending list for scheduler to sweep and schedule
-		list_push_sl(&pending_list, task);
+void OS_sleepUntil_delegate(_OS_SVC_StackFrame_t * stack);
+/* Function to put a task to sleep until the start of its next period. Function
+	 takes in a pointer to the task's last release time, and the period in ticks.
+	 The release time is advanced by one period and written back, if it is still
+	 in the future the task sleeps until then, otherwise it carries on running. */
+void OS_sleepUntil_delegate(_OS_SVC_StackFrame_t * stack) {
+	// Get the pointer to the last release time and the period that have been passed in
+	uint64_t * lastWake = (uint64_t *) stack->r0;
+	uint32_t period = stack->r1;
+	// the next release is exactly one period after the last, regardless of the current time
+	uint64_t wakeTime = *lastWake + period;
+	*lastWake = wakeTime;
+	// only sleep if the next release hasn't already passed
+	if (wakeTime > OS_elapsedTicks64()) {
+		_sleep_until(wakeTime);
+	}
+}
+
+/* Function to recompute a task's inherited priority level when it has released a
+	 mutex. The task's priority is recomputed as the highest of its original priority
+	 and the highest priority task waiting on each mutex that it still holds, so
+	 holding a second contended mutex keeps the task promoted. The released mutex must
+	 already be off the task's held list. Function takes in the pointer to the task.
+	 Returns 1 if the task's priority changed, since another task may now need to run. */
+uint_fast8_t _OS_inheritance_restore(OS_TCB_t * task) {
+	// inherit from the top waiter of every mutex that is still held
+	_rank_t rank = _OWN_RANK(task);
+	for (OS_mutex_t * held = task->heldMutexes; held; held = held->nextHeld) {
+		OS_TCB_t const * waiter = OS_heap_peek(&held->waiting_heap);
+		if (waiter && _RANK(waiter) < rank) {
+			rank = _RANK(waiter);
+		}
+	}
+	if (rank != _RANK(task)) {
+		_set_rank(task, rank);
+		return 1;
+	}
+	return 0;
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void OS_waitForNextPeriod_delegate(void);
+/* Function to end the current job of a periodic task. A job that finishes after
+	 its absolute deadline is counted as a deadline miss. The release time is then
+	 advanced by one period, and the task sleeps until the next release, or starts
+	 the next job straight away if the release has already passed. */
+void OS_waitForNextPeriod_delegate(void) {
+	// The running task's TCB is retrieved and stored
+	OS_TCB_t * currentTask = OS_currentTCB();
+	uint64_t const now = OS_elapsedTicks64();
+	// count the job as a miss if it has finished after its own deadline
+	if (currentTask->relativeDeadline && now > _own_deadline(currentTask)) {
+		currentTask->deadlineMisses++;
+	}
+	// the next job is released exactly one period after this one
+	currentTask->release += currentTask->period;
+	if (currentTask->release > now) {
+		// sleep until the release, the deadline is set when the task wakes
+		_sleep_until(currentTask->release);
+	} else {
+		// the release has already passed, so the next job starts now with its new deadline
+		currentTask->absoluteDeadline = _own_deadline(currentTask);
+#if _OS_SCHEDULER_EDF
+		// re-sort the task into the ready list behind any earlier deadlines
+		_ready_remove(currentTask);
+		_ready_add(currentTask);
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+#endif
 	}
 }
@@ -14,8 +14,18 @@ void OS_semaphore_initialise(OS_semaphore_t * semaphore, uint32_t totalTokens) {
 	 loads the semaphore token counter to ensure thread safety. If the semaphore has tokens
 	 available, the token count is decremented and stored exclusively. If the semaphore has no
 	 tokens left, the semaphore-based wait delegate function is called to send the requesting
-	 task to the waiting list. */
+	 task to the waiting list. With hand-off enabled, a task woken with a token needs no retry. */
 void OS_semaphore_acquire(OS_semaphore_t * semaphore) {
+	OS_semaphore_acquire_timeout(semaphore, OS_WAIT_FOREVER);
+}
+
+/* A function that a task can use to acquire a semaphore, giving up if no token has become available
+	 once the timeout has run out. The acquisition works as above, and each wait is given what is left
+	 of the timeout. Function takes in a pointer to the semaphore and the timeout in ticks. Returns 0 if
+	 a token was acquired, or 1 if the timeout ran out. */
+int_fast8_t OS_semaphore_acquire_timeout(OS_semaphore_t * semaphore, uint32_t timeout) {
+	OS_TCB_t const * currentTCB = OS_currentTCB();
+	uint64_t const deadline = _OS_timeout_deadline(timeout);
 	while (1) {
 		// get and store the current semaphore notification count
 		uint32_t checkCode = semaphore->notificationCounter;
@@ -25,21 +35,44 @@ void OS_semaphore_acquire(OS_semaphore_t * semaphore) {
 		if (tokens) {
 			// try to exclusively store the decremented token counter field
 			if (!(__STREXW ((uint32_t)(--tokens), (uint32_t *)&(semaphore->tokenCounter)))) {
-				// if STREXW succeeds, then current TCB has acquired the mutex, break out of while loop
-				break;
+				// if STREXW succeeds, then current TCB has acquired a token
+				return 0;
 			}
 			// if STREX fails, the semaphore was obtained during this logic. Keep iterating while loop
 		} else {
+			__CLREX();
+			uint32_t const remaining = _OS_timeout_remaining(deadline);
+			if (!remaining) {
+				return 1;
+			}
 			// if the number of available tokens is zero, the requesting task must wait
-			OS_semaphore_wait((uint32_t)semaphore, checkCode);
+			OS_semaphore_wait((uint32_t)semaphore, checkCode, remaining);
+#if _OS_SEMAPHORE_HANDOFF
+			if (currentTCB->waitStatus == TASK_WAIT_HANDOFF) {
+				return 0;
+			}
+#endif
+			if (currentTCB->waitStatus == TASK_WAIT_TIMEOUT) {
+				return 1;
+			}
 		}
 	}
 }
 
 /* A function that can be called by any task or ISR to release a semaphore, addressed by a
 	 pointer. Exclusively loads the semaphore token counter to then decrement and exclusively
-	 store ensuring thread safety. On successful semaphore release, a waiting task is notified. */
+	 store ensuring thread safety. On successful semaphore release, a waiting task is notified, and
+	 the scheduler is invoked if that task should preempt the current one. With hand-off enabled,
+	 if a task is waiting, the token goes straight to it and the count is left alone. */
 void OS_semaphore_release(OS_semaphore_t * semaphore) {
+#if _OS_SEMAPHORE_HANDOFF
+	OS_TCB_t * waitingTask = list_pop_tail_sl(&(semaphore->waiting_list));
+	if (waitingTask) {
+		waitingTask->waitStatus = TASK_WAIT_HANDOFF;
+		_OS_semaphore_preempt(_OS_wake(waitingTask));
+		return;
+	}
+#endif
 	while (1) {
 		// exclusively load the token counter field of semaphore
 		uint32_t tokens = __LDREXW ((uint32_t volatile *)&(semaphore->tokenCounter));
@@ -51,27 +84,34 @@ void OS_semaphore_release(OS_semaphore_t * semaphore) {
 	}
 	/* breaking out of while loop signifying successful token increase, thus semaphore release,
 		 therefore we can notify a waiting task. */
-	_OS_semaphore_notify(semaphore);
-	/* After notifying waiting task, we invoke a context switch to prevent a spinlock as a task
-		 may immediately re-acquire the semaphore after releasing in a tight loop. In order to ensure
-		 successful yielding in both standard functions and ISRs, logic must detect whether the CPU
-		 is in handler-mode (ISR execution) or thread-mode (most standard code). If the CPU is in
-		 handler-mode, a manual PendSV bit set must occur, otherwise, the yield delegate can be
-		 called. The IPSR register the exception number of the exception being processed, with the
-		 field set to 0 if there is no active interrupt. */
+	_OS_semaphore_preempt(_OS_semaphore_notify(semaphore));
+}
+
+/* A function that invokes the scheduler after a semaphore release if the woken task should preempt
+	 the current one. Function takes in the result of waking the task. */
+void _OS_semaphore_preempt(uint_fast8_t preempt) {
+	if (!preempt) {
+		return;
+	}
+	/* The woken task should preempt the current one. In order to invoke the scheduler in both
+		 standard functions and ISRs, logic must detect whether the CPU is in handler-mode (ISR
+		 execution) or thread-mode (most standard code). If the CPU is in handler-mode, a manual
+		 PendSV bit set must occur, otherwise, the schedule delegate can be called. The IPSR
+		 register the exception number of the exception being processed, with the field set to 0
+		 if there is no active interrupt. */
 	uint32_t handlerMode = __get_IPSR();
 	if (handlerMode) {
 		// set PendSV bit to invoke context switch
 		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	} else {
-		// call yield delegate to invoke context switch
-		OS_yield();
+		// call schedule delegate to invoke context switch
+		OS_schedule();
 	}
 }
 
 /* A function that notifies a waiting task of semaphore release. Function takes in a pointer
-	 to the semaphore. */
-void _OS_semaphore_notify(OS_semaphore_t * semaphore) {
+	 to the semaphore. Returns 1 if the notified task should preempt the current one. */
+uint_fast8_t _OS_semaphore_notify(OS_semaphore_t * semaphore) {
 	while (1) {
 		// exclusively load the notification counter field of semaphore
 		uint32_t notifications = __LDREXW ((uint32_t volatile *)&(semaphore->notificationCounter));
@@ -86,6 +126,7 @@ void _OS_semaphore_notify(OS_semaphore_t * semaphore) {
 	// check if there is a waiting task present
 	if (waitingTask) {
 		// move this task to the pending list
-		list_push_sl(&pending_list, waitingTask);
+		return _OS_wake(waitingTask);
 	}
+	return 0;
 }
@@ -0,0 +1,51 @@
+#include "OS/seqlock.h"
+
+#include "stm32f4xx.h"
+
+/* A function that initialises a sequence lock, addressed by a pointer, in preparation for use.
+	 Function takes in a pointer to the lock to initialise. */
+void OS_seqlock_initialise(OS_seqlock_t * lock) {
+	lock->sequence = 0;
+	lock->savedCeiling = _OS_PRIORITY_LEVELS;
+}
+
+/* A function that a task can use to start writing the data protected by a sequence lock. The task's
+	 ceiling is raised to the highest priority so that it can't be preempted by another task mid-write,
+	 then the sequence number is made odd. If the number is odd already, another writer has blocked
+	 inside its write section, so the ceiling is put back and the task yields until that write is
+	 finished. Function takes in a pointer to the lock. */
+void OS_seqlock_writeBegin(OS_seqlock_t * lock) {
+	OS_TCB_t *currentTCB = OS_currentTCB();
+	uint_fast16_t const savedCeiling = currentTCB->ceiling;
+	while (1) {
+		currentTCB->ceiling = 0;
+		uint32_t sequence = __LDREXW (&(lock->sequence));
+		if (!(sequence & 1UL)) {
+			if (!(__STREXW (sequence + 1, &(lock->sequence)))) {
+				break;
+			}
+		} else {
+			__CLREX();
+			currentTCB->ceiling = savedCeiling;
+			OS_yield();
+		}
+	}
+	lock->savedCeiling = savedCeiling;
+	// the data must not be stored before the sequence number
+	__DMB();
+}
+
+/* A function that a task can use to finish writing the data protected by a sequence lock. The sequence
+	 number is made even again, and the task's ceiling is put back. If a higher priority task was made
+	 ready during the write, the scheduler is invoked to let it run. Function takes in a pointer to the
+	 lock. */
+void OS_seqlock_writeEnd(OS_seqlock_t * lock) {
+	OS_TCB_t *currentTCB = OS_currentTCB();
+	// the data must have been stored before the sequence number
+	__DMB();
+	lock->sequence = lock->sequence + 1;
+	currentTCB->ceiling = lock->savedCeiling;
+	if (currentTCB->state & TASK_STATE_DEFERRED) {
+		OS_schedule();
+	}
+}
@@ -0,0 +1,23 @@
+#include "OS/static_alloc.h"
+#include <stdint.h>
+
+// 16KB pool size
+#define STATIC_ALLOC_POOLSIZE 16384UL
+// boundary for double-word alignment
+#define STATIC_ALLOC_ALIGNMENT 8U
+
+static uint8_t static_pool[STATIC_ALLOC_POOLSIZE] __attribute__ (( aligned(STATIC_ALLOC_ALIGNMENT) ));
+static size_t pool_index = STATIC_ALLOC_POOLSIZE;
+
+/* Bump allocator that hands out 8-byte aligned blocks from the top of a static pool. Blocks
+	 can't be freed, it is only used to carve out the storage for memory pools. Returns NULL if
+	 the pool is exhausted. */
+void * static_alloc(size_t bytes) {
+	if (pool_index > bytes) {
+		pool_index -= bytes;
+		pool_index &= ~(STATIC_ALLOC_ALIGNMENT - 1);
+		return static_pool + pool_index;
+	} else {
+		return 0;
+	}
+}
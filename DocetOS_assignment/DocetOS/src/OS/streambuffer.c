@@ -0,0 +1,139 @@
+#include "OS/streambuffer.h"
+
+#include "stm32f4xx.h"
+
+/* A function that initialises a stream buffer, addressed by a pointer, in preparation for use. Function
+	 takes in a pointer to the stream buffer, a pointer to its store, the size of the store in bytes, and
+	 the trigger level in bytes, which is limited to what the store can hold. */
+void OS_streamBuffer_initialise(OS_streamBuffer_t * buffer, void * store, uint32_t size, uint32_t trigger) {
+	buffer->store = store;
+	buffer->size = size;
+	buffer->head = 0;
+	buffer->tail = 0;
+	if (!trigger) {
+		trigger = 1;
+	} else if (trigger > size - 1) {
+		trigger = size - 1;
+	}
+	buffer->trigger = trigger;
+	buffer->waitLevel = trigger;
+	buffer->waiter = 0;
+}
+
+/* A function that returns the number of bytes available to read from a stream buffer. Function takes in
+	 a pointer to the stream buffer. */
+uint32_t OS_streamBuffer_available(OS_streamBuffer_t const * buffer) {
+	uint32_t const head = buffer->head;
+	uint32_t const tail = buffer->tail;
+	return (head >= tail) ? (head - tail) : (buffer->size - tail + head);
+}
+
+/* A function that takes the blocked consumer out of a stream buffer, so that it can be woken, with an
+	 exclusive store so that only one of the producer, the consumer's own wait delegate and the scheduler's
+	 timeout can claim it. It is also the cancel function for a timed wait, see _OS_block_timeout().
+	 Function takes in the consumer task, whose waitObject field is the stream buffer. Returns 1 if the
+	 task was claimed, or 0 if it had already been claimed by another. */
+static uint_fast8_t _streamBuffer_claim(OS_TCB_t * task) {
+	OS_streamBuffer_t * buffer = task->waitObject;
+	while (1) {
+		OS_TCB_t * waiter = (OS_TCB_t *) __LDREXW ((uint32_t volatile *)&(buffer->waiter));
+		if (waiter != task) {
+			__CLREX();
+			return 0;
+		}
+		if (!(__STREXW (0, (uint32_t volatile *)&(buffer->waiter)))) {
+			return 1;
+		}
+	}
+}
+
+/* A function that the producer uses to write bytes to a stream buffer. The bytes are copied in before
+	 the head index is moved past them, so the consumer never sees bytes that aren't there yet. If that
+	 brings the buffer up to the level a blocked consumer is waiting for, the consumer is woken, and the
+	 scheduler is invoked if it should preempt. Function takes in a pointer to the stream buffer, a
+	 pointer to the bytes, and the number of bytes. Returns the number of bytes written. */
+uint32_t OS_streamBuffer_send(OS_streamBuffer_t * buffer, void const * data, uint32_t length) {
+	uint8_t const * bytes = data;
+	uint32_t head = buffer->head;
+	uint32_t const space = buffer->size - 1 - OS_streamBuffer_available(buffer);
+	if (length > space) {
+		length = space;
+	}
+	for (uint32_t i = 0; i < length; i++) {
+		buffer->store[head] = bytes[i];
+		if (++head == buffer->size) {
+			head = 0;
+		}
+	}
+	// the bytes must be stored before the head index
+	__DMB();
+	buffer->head = head;
+	OS_TCB_t * waiter = buffer->waiter;
+	if (waiter && OS_streamBuffer_available(buffer) >= buffer->waitLevel && _streamBuffer_claim(waiter)) {
+		waiter->waitStatus = TASK_WAIT_NOTIFIED;
+		if (_OS_wake(waiter)) {
+			// the IPSR register is non-zero in handler mode, see _OS_semaphore_preempt()
+			if (__get_IPSR()) {
+				SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+			} else {
+				OS_schedule();
+			}
+		}
+	}
+	return length;
+}
+
+/* A function that the consumer task uses to read bytes from a stream buffer. If fewer bytes than the
+	 level are available and the timeout isn't 0, the task waits for them first. Whatever is available is
+	 then copied out, and the tail index moved past it. Function takes in a pointer to the stream buffer,
+	 a pointer to copy the bytes to, the maximum number of bytes, and the timeout in ticks. Returns the
+	 number of bytes read. */
+uint32_t OS_streamBuffer_receive(OS_streamBuffer_t * buffer, void * data, uint32_t length, uint32_t timeout) {
+	uint32_t const level = (length < buffer->trigger) ? length : buffer->trigger;
+	uint32_t available = OS_streamBuffer_available(buffer);
+	if (available < level && timeout) {
+		buffer->waitLevel = level;
+		OS_streamBuffer_wait_svc((uint32_t)buffer, timeout);
+		available = OS_streamBuffer_available(buffer);
+	}
+	if (length > available) {
+		length = available;
+	}
+	// the bytes must not be loaded before the head index
+	__DMB();
+	uint8_t * bytes = data;
+	uint32_t tail = buffer->tail;
+	for (uint32_t i = 0; i < length; i++) {
+		bytes[i] = buffer->store[tail];
+		if (++tail == buffer->size) {
+			tail = 0;
+		}
+	}
+	// the bytes must be loaded before the tail index frees their space
+	__DMB();
+	buffer->tail = tail;
+	return length;
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_streamBuffer_wait_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that blocks the consumer of a stream buffer until enough bytes are
+	 available, or the timeout runs out. The task is blocked before it is published
+	 as the waiter, and the level is checked again afterwards, so bytes written in
+	 between aren't missed. If they are there, the task claims itself back from the
+	 producer and wakes itself. Function takes in a pointer to the stream buffer, and
+	 the timeout in ticks. */
+void _OS_streamBuffer_wait_delegate(_OS_SVC_StackFrame_t * stack) {
+	OS_streamBuffer_t * buffer = (OS_streamBuffer_t *) stack->r0;
+	uint32_t timeout = stack->r1;
+	OS_TCB_t * currentTask = OS_currentTCB();
+	currentTask->waitStatus = TASK_WAIT_NOTIFIED;
+	currentTask->waitObject = buffer;
+	_OS_block_timeout(timeout, _streamBuffer_claim);
+	buffer->waiter = currentTask;
+	if (OS_streamBuffer_available(buffer) >= buffer->waitLevel && _streamBuffer_claim(currentTask)) {
+		_OS_wake(currentTask);
+	}
+}
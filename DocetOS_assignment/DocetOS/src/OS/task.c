@@ -0,0 +1,91 @@
+#define OS_INTERNAL
+
+#include "OS/task.h"
+#include "OS/os.h"
+#include "OS/mempool.h"
+
+#include "stm32f4xx.h"
+
+/* Dynamic task creation from size-classed pools.
+
+	 Each block holds a TCB, padded to keep the stack 8-byte aligned, followed by the stack. Blocks are
+	 only ever allocated in the create task SVC delegate and freed by the scheduler in PendSV, which
+	 can't preempt each other, so the pools don't need to be atomic. A task that exits can't be freed
+	 straight away, since its stack is still in use until the context switch away from it, so the
+	 scheduler frees it on a later pass (see _OS_taskExit_delegate()). */
+
+// size of the TCB part of a block, rounded up so that the stack that follows it is 8-byte aligned
+#define _OS_TASK_TCB_SIZE ((sizeof(OS_TCB_t) + 7U) & ~7U)
+
+static uint32_t const _stack_words[_OS_TASK_POOL_CLASSES] = _OS_TASK_POOL_STACK_WORDS;
+static uint32_t const _blocks[_OS_TASK_POOL_CLASSES] = _OS_TASK_POOL_BLOCKS;
+static mempool_t _pools[_OS_TASK_POOL_CLASSES];
+static uint_fast8_t _pools_ready = 0;
+
+/* Internal function to carve out the storage for every pool, called on the first task creation. */
+static void _pools_init(void) {
+	for (uint_fast8_t i = 0; i < _OS_TASK_POOL_CLASSES; i++) {
+		_pools[i].head = 0;
+		pool_init(&_pools[i], _OS_TASK_TCB_SIZE + (_stack_words[i] * sizeof(uint32_t)), _blocks[i]);
+	}
+	_pools_ready = 1;
+}
+
+/* Function that creates a task from the dynamic task pools. See task.h for details. */
+OS_TCB_t * OS_createTask(void (* const func)(void const * const), void const * const data, uint_fast8_t const priority, uint32_t const stackWords) {
+	_OS_taskParams_t params = {
+		.func = func,
+		.data = data,
+		.priority = priority,
+		.stackWords = stackWords
+	};
+	return (OS_TCB_t *) OS_createTask_svc((uint32_t)&params);
+}
+
+/* Since delegate functions are branched to and not directly accessed via C
+   function calls, the prototype does not need to be in the header file, they
+   can be placed right above the function for readability. */
+void _OS_createTask_delegate(_OS_SVC_StackFrame_t * stack);
+/* SVC handler that allocates a block for a new task from the smallest size class
+	 that fits, initialises the TCB and stack in it, and makes the task ready. The
+	 function takes in a pointer to the task parameters, and returns the TCB through
+	 the stacked r0, or NULL if no block was free. */
+void _OS_createTask_delegate(_OS_SVC_StackFrame_t * stack) {
+	_OS_taskParams_t const * params = (_OS_taskParams_t const *) stack->r0;
+	stack->r0 = 0;
+	if (!_pools_ready) {
+		_pools_init();
+	}
+	// find the smallest class that fits the stack and still has a free block
+	uint8_t * block = 0;
+	uint_fast8_t i = 0;
+	for (; i < _OS_TASK_POOL_CLASSES; i++) {
+		if (_stack_words[i] >= params->stackWords) {
+			block = pool_allocate(&_pools[i]);
+			if (block) {
+				break;
+			}
+		}
+	}
+	if (!block) {
+		return;
+	}
+	OS_TCB_t * tcb = (OS_TCB_t *) block;
+	// the stack is full descending, so the task starts at the top of the block
+	uint32_t * const stackTop = (uint32_t *)(block + _OS_TASK_TCB_SIZE) + _stack_words[i];
+	OS_initialiseTCB(tcb, stackTop, params->func, params->data, params->priority);
+	tcb->pool = &_pools[i];
+	if (!_currentTCB) {
+		// the OS hasn't started, so the task can go straight into the ready lists
+		OS_addTask(tcb);
+	} else if (_OS_wake(tcb)) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+	stack->r0 = (uint32_t) tcb;
+}
+
+/* Function that returns the memory of an exited pooled task to the pool it came from. Function
+	 takes in a pointer to the TCB at the start of the block. */
+void _OS_task_free(OS_TCB_t * tcb) {
+	pool_deallocate((mempool_t *) tcb->pool, tcb);
+}
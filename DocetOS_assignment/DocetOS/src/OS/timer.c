@@ -0,0 +1,182 @@
+#include "OS/timer.h"
+#include "OS/queue.h"
+#include "OS/task.h"
+
+#include "stm32f4xx.h"
+
+/* Software timers.
+
+	 All of the timer state is owned by the daemon task. Tasks and ISRs only send it commands through a
+	 message queue, stamped with the tick they were issued at, so no locking is needed, and a timer
+	 started from an ISR is timed from the interrupt rather than from when the daemon gets to run. The
+	 running timers are linked through their next fields in order of expiry time, so there is no limit
+	 on how many can run, and the earliest is always at the head. The daemon blocks on the command queue
+	 with a timeout of the time left until the earliest expiry, so it only runs when there is a command
+	 or a timer to dispatch, and takes no ticks of its own while waiting. */
+
+/* Commands sent to the daemon. */
+#define _OS_TIMER_START 0U
+#define _OS_TIMER_STOP  1U
+
+typedef struct {
+	OS_timer_t * timer;
+	uint32_t command;
+	// the tick at which the command was issued
+	uint64_t issued;
+} _OS_timerCommand_t;
+
+static _OS_timerCommand_t _command_store[_OS_TIMER_COMMAND_QUEUE_SIZE];
+static OS_queue_t _commands;
+
+// the running timers, earliest expiry first
+static OS_timer_t * _active;
+
+// the daemon task, so that commands from its own callbacks can be recognised
+static OS_TCB_t * _daemon;
+
+/* A function that links a timer into the running timers behind every timer that expires before it or
+	 at the same time, so timers due on the same tick run in the order they were started. Function takes
+	 in a pointer to the timer. */
+static void _timer_insert(OS_timer_t * timer) {
+	OS_timer_t ** link = &_active;
+	while (*link && (*link)->expiry <= timer->expiry) {
+		link = &(*link)->next;
+	}
+	timer->next = *link;
+	*link = timer;
+	timer->active = 1;
+}
+
+/* A function that unlinks a running timer from the running timers. Function takes in a pointer to the
+	 timer. */
+static void _timer_remove(OS_timer_t * timer) {
+	for (OS_timer_t ** link = &_active; *link; link = &(*link)->next) {
+		if (*link == timer) {
+			*link = timer->next;
+			break;
+		}
+	}
+	timer->next = 0;
+	timer->active = 0;
+}
+
+/* A function that applies a command to a timer. Starting takes a running timer out of the list first,
+	 so that it is restarted rather than added twice. Function takes in a pointer to the command. */
+static void _timer_command(_OS_timerCommand_t const * command) {
+	OS_timer_t * timer = command->timer;
+	if (timer->active) {
+		_timer_remove(timer);
+	}
+	if (command->command == _OS_TIMER_START) {
+		timer->expiry = command->issued + timer->period;
+		_timer_insert(timer);
+	}
+}
+
+/* A function that calls the callback of every timer that has expired, earliest first. Auto-reload
+	 timers are put back for their next period before their callback runs, so the callback can stop
+	 them. A timer that has fallen more than a period behind skips the periods it missed rather than
+	 running back-to-back to catch up. Function takes in the current tick. */
+static void _timer_dispatch(uint64_t now) {
+	OS_timer_t * timer;
+	while ((timer = _active) && timer->expiry <= now) {
+		_timer_remove(timer);
+		if (timer->autoReload && timer->period) {
+			timer->expiry += timer->period;
+			if (timer->expiry <= now) {
+				timer->expiry = now + timer->period;
+			}
+			_timer_insert(timer);
+		}
+		timer->callback(timer);
+	}
+}
+
+/* The timer daemon task. It waits for a command for as long as the earliest running timer allows,
+	 then applies any command it received and dispatches whatever has expired. */
+__attribute__((noreturn))
+static void _timer_daemon(void const * const data) {
+	(void) data;
+	while (1) {
+		uint32_t timeout = OS_WAIT_FOREVER;
+		OS_timer_t const * next = _active;
+		if (next) {
+			uint64_t const now = OS_elapsedTicks64();
+			uint64_t const left = (next->expiry > now) ? (next->expiry - now) : 0;
+			timeout = (left < OS_WAIT_FOREVER) ? (uint32_t) left : (OS_WAIT_FOREVER - 1);
+		}
+		_OS_timerCommand_t command;
+		if (!OS_queue_receive_timeout(&_commands, &command, timeout)) {
+			_timer_command(&command);
+		}
+		_timer_dispatch(OS_elapsedTicks64());
+	}
+}
+
+/* A function that creates the timer daemon and the structures it uses. Returns 1 if there was no block
+	 in the task pools for the daemon, otherwise 0. */
+int_fast8_t OS_timer_initialiseDaemon(void) {
+	OS_queue_initialise(&_commands, _command_store, sizeof(_OS_timerCommand_t), _OS_TIMER_COMMAND_QUEUE_SIZE);
+	_active = 0;
+	_daemon = OS_createTask(_timer_daemon, 0, _OS_TIMER_DAEMON_PRIORITY, _OS_TIMER_DAEMON_STACK_WORDS);
+	return !_daemon;
+}
+
+/* A function that initialises a timer, addressed by a pointer, in preparation for use. Function takes in
+	 a pointer to the timer, the callback and its data, the period in ticks, and non-zero for a timer that
+	 reloads automatically. */
+void OS_timer_initialise(OS_timer_t * timer, void (* callback)(OS_timer_t * timer), void * data, uint32_t period, uint_fast8_t autoReload) {
+	timer->callback = callback;
+	timer->data = data;
+	timer->period = period;
+	timer->autoReload = autoReload;
+	timer->expiry = 0;
+	timer->active = 0;
+	timer->next = 0;
+}
+
+/* A function that sends a command to the timer daemon. Tasks wait if the command queue is full, ISRs
+	 can't, so the command fails instead. Before OS_start() there is no task to wait and the daemon isn't
+	 running, so the command is applied directly. A callback running in the daemon would wait on itself
+	 forever if the queue was full, so its commands are applied directly too, after any commands already
+	 queued, so that they are still applied in the order they were issued. Function takes in a pointer to
+	 the timer and the command. Returns 1 if the command couldn't be sent, otherwise 0. */
+static int_fast8_t _timer_send(OS_timer_t * timer, uint32_t command) {
+	_OS_timerCommand_t const message = { .timer = timer, .command = command, .issued = OS_elapsedTicks64() };
+	// the IPSR register is non-zero in handler mode, see _OS_semaphore_preempt()
+	if (__get_IPSR()) {
+		return OS_queue_trySend(&_commands, &message);
+	}
+	OS_TCB_t const * currentTCB = OS_currentTCB();
+	if (currentTCB && currentTCB == _daemon) {
+		_OS_timerCommand_t queued;
+		while (!OS_queue_tryReceive(&_commands, &queued)) {
+			_timer_command(&queued);
+		}
+	}
+	if (!currentTCB || currentTCB == _daemon) {
+		_timer_command(&message);
+		return 0;
+	}
+	OS_queue_send(&_commands, &message);
+	return 0;
+}
+
+/* A function that a task or ISR can use to start a timer. Function takes in a pointer to the timer.
+	 Returns 1 if the command couldn't be sent, otherwise 0. */
+int_fast8_t OS_timer_start(OS_timer_t * timer) {
+	return _timer_send(timer, _OS_TIMER_START);
+}
+
+/* A function that a task or ISR can use to stop a timer. Function takes in a pointer to the timer.
+	 Returns 1 if the command couldn't be sent, otherwise 0. */
+int_fast8_t OS_timer_stop(OS_timer_t * timer) {
+	return _timer_send(timer, _OS_TIMER_STOP);
+}
+
+/* A function that a task or ISR can use to restart a timer from now. Starting a timer already restarts
+	 it if it is running, so this is the same command. Function takes in a pointer to the timer. Returns
+	 1 if the command couldn't be sent, otherwise 0. */
+int_fast8_t OS_timer_reset(OS_timer_t * timer) {
+	return _timer_send(timer, _OS_TIMER_START);
+}
@@ -0,0 +1,95 @@
+#include "OS/waitqueue.h"
+
+/* Function to check whether a task should be woken before another, which is when it has a higher
+	 priority (denoted with a smaller numeric value), or an earlier deadline under EDF. */
+static uint_fast8_t _waitqueue_before(OS_TCB_t const * task1, OS_TCB_t const * task2) {
+#if _OS_SCHEDULER_EDF
+	return task1->absoluteDeadline < task2->absoluteDeadline;
+#else
+	return task1->priority < task2->priority;
+#endif
+}
+
+/* A function that initialises a wait queue, addressed by a pointer, in preparation for use.
+	 Function takes in a pointer to the wait queue to initialise. */
+void OS_waitqueue_initialise(OS_waitqueue_t * queue) {
+	queue->head = 0;
+}
+
+/* A function that checks if a wait queue is empty, returning a 1 if empty, and a 0 if tasks are
+	 waiting in it. Function takes in a pointer to the wait queue. */
+uint_fast8_t OS_waitqueue_isEmpty(OS_waitqueue_t * queue) {
+	return !queue->head;
+}
+
+/* A function that links a blocked task into a wait queue behind every task that should be woken
+	 before it or at the same time, and records the queue in the task's TCB, so that a priority change
+	 can re-sort it, until the task is taken back out. Function takes in a pointer to the wait queue
+	 and the task. */
+void _OS_waitqueue_insert(OS_waitqueue_t * queue, OS_TCB_t * task) {
+	OS_TCB_t * prev = 0;
+	OS_TCB_t * next = queue->head;
+	while (next && !_waitqueue_before(task, next)) {
+		prev = next;
+		next = next->next;
+	}
+	task->prev = prev;
+	task->next = next;
+	if (next) {
+		next->prev = task;
+	}
+	if (prev) {
+		prev->next = task;
+	} else {
+		queue->head = task;
+	}
+	task->waitQueue = queue;
+}
+
+/* A function that blocks the current task: it is removed from the scheduler and inserted into the
+	 wait queue, and PendSV is set to switch to another task. Function takes in a pointer to the wait
+	 queue. */
+void _OS_waitqueue_block(OS_waitqueue_t * queue) {
+	OS_TCB_t * currentTask = OS_currentTCB();
+	_OS_block();
+	_OS_waitqueue_insert(queue, currentTask);
+}
+
+/* A function that blocks the current task in a wait queue as above, and unless the timeout is
+	 OS_WAIT_FOREVER, also sets a timeout for it. Function takes in a pointer to the wait queue, the
+	 timeout in ticks, and the function to take the task out of the waited-on object if it runs out. */
+void _OS_waitqueue_block_timeout(OS_waitqueue_t * queue, uint32_t timeout, uint_fast8_t (* cancel)(OS_TCB_t * task)) {
+	OS_TCB_t * currentTask = OS_currentTCB();
+	_OS_block_timeout(timeout, cancel);
+	_OS_waitqueue_insert(queue, currentTask);
+}
+
+/* A function that takes a given task out of a wait queue, wherever it is in the queue. Function takes
+	 in a pointer to the wait queue and the task. Returns 1 if the task was removed, or 0 if it wasn't
+	 in the wait queue. */
+uint_fast8_t _OS_waitqueue_remove(OS_waitqueue_t * queue, OS_TCB_t * task) {
+	if (task->waitQueue != queue) {
+		return 0;
+	}
+	if (task->prev) {
+		task->prev->next = task->next;
+	} else {
+		queue->head = task->next;
+	}
+	if (task->next) {
+		task->next->prev = task->prev;
+	}
+	task->prev = task->next = 0;
+	task->waitQueue = 0;
+	return 1;
+}
+
+/* A function that takes the highest priority task out of a wait queue. Function takes in a pointer
+	 to the wait queue. Returns the task, or NULL if no task is waiting. */
+OS_TCB_t * _OS_waitqueue_pop(OS_waitqueue_t * queue) {
+	OS_TCB_t * task = queue->head;
+	if (task) {
+		_OS_waitqueue_remove(queue, task);
+	}
+	return task;
+}
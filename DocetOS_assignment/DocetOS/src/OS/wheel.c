@@ -0,0 +1,174 @@
+#include "OS/wheel.h"
+
+#include "stm32f4xx.h"
+
+/* A hierarchical timing wheel of sleeping tasks.
+
+	 Level 0 has one slot per tick. A slot in level n covers 32^n ticks, and the tasks in it are
+	 cascaded (re-inserted into the lower levels) when the wheel time reaches the start of the slot.
+	 Inserting a task is therefore O(1), and every task is moved at most once per level before it
+	 expires, giving amortised O(1) expiry regardless of the number of sleeping tasks.
+
+	 Tasks are linked into the slots through the intrusive timerNext/timerPrev fields of the TCB, so
+	 the wheel has no fixed capacity. timerPrev points at whichever pointer points at the task (the
+	 slot head or the previous task's timerNext), which allows O(1) removal from any slot. A NULL
+	 timerPrev means the task is not in the wheel. */
+
+/* Internal wheel function to link a task in at the head of a slot and flag the slot as occupied. */
+static void _wheel_link(OS_wheel_t * wheel, uint_fast8_t level, uint_fast8_t index, OS_TCB_t * task) {
+	OS_TCB_t ** head = &wheel->slot[level][index];
+	// the old head of the slot follows the new task
+	task->timerNext = *head;
+	if (*head) {
+		(*head)->timerPrev = &task->timerNext;
+	}
+	// the new task is pointed at by the slot head
+	task->timerPrev = head;
+	*head = task;
+	wheel->occupied[level] |= 1UL << index;
+}
+
+/* Internal wheel function to place a task in the slot matching the distance between its wake time and
+	 the given base time. The wake time must not be before the base time. */
+static void _wheel_place(OS_wheel_t * wheel, OS_TCB_t * task, uint64_t base) {
+	uint64_t wakeTime = task->wakeTime;
+	uint64_t delta = wakeTime - base;
+	// wake times beyond the top level are parked at its far end, and cascaded back into it until in range
+	if (delta >= (1UL << (_OS_WHEEL_SLOT_BITS * _OS_WHEEL_LEVELS))) {
+		delta = (1UL << (_OS_WHEEL_SLOT_BITS * _OS_WHEEL_LEVELS)) - 1;
+		wakeTime = base + delta;
+	}
+	// the level is the lowest one whose range covers the distance, found from the number of bits in it
+	uint_fast8_t level = 0;
+	if (delta) {
+		level = (uint_fast8_t)((31 - __CLZ((uint32_t)delta)) / _OS_WHEEL_SLOT_BITS);
+	}
+	uint_fast8_t const index = (wakeTime >> (_OS_WHEEL_SLOT_BITS * level)) & (_OS_WHEEL_SLOTS - 1);
+	_wheel_link(wheel, level, index, task);
+}
+
+/* Internal wheel function to detach the whole list of tasks in a slot. Returns the first task of the
+	 detached list, which stays linked through the timerNext fields. */
+static OS_TCB_t * _wheel_detach(OS_wheel_t * wheel, uint_fast8_t level, uint_fast8_t index) {
+	OS_TCB_t * task = wheel->slot[level][index];
+	wheel->slot[level][index] = 0;
+	wheel->occupied[level] &= ~(1UL << index);
+	return task;
+}
+
+/* A function that checks if the wheel is empty, returning a 1 if empty, and a 0 if the wheel
+	 contains tasks. Function takes in a pointer to the wheel. */
+uint_fast8_t OS_wheel_isEmpty(OS_wheel_t * wheel) {
+	return !(wheel->count);
+}
+
+/* A function to insert a task into the wheel. The task expires at the wake time stored in its
+	 wakeTime field, a wake time that has already passed expires on the next tick. Function takes in
+	 a pointer to the wheel and a pointer to the task to insert. */
+void OS_wheel_insert(OS_wheel_t * wheel, OS_TCB_t * task) {
+	// the wheel has already been advanced to wheel->time, so the earliest a task can expire is the tick after
+	if (task->wakeTime <= wheel->time) {
+		task->wakeTime = wheel->time + 1;
+	}
+	_wheel_place(wheel, task, wheel->time);
+	wheel->count++;
+}
+
+/* A function to remove a task from the wheel before it expires. Does nothing if the task is not in
+	 the wheel. Function takes in a pointer to the wheel and a pointer to the task to remove. */
+void OS_wheel_remove(OS_wheel_t * wheel, OS_TCB_t * task) {
+	OS_TCB_t ** const prev = task->timerPrev;
+	// only proceed if the task is in the wheel
+	if (!prev) {
+		return;
+	}
+	// unlink the task from its neighbours
+	*prev = task->timerNext;
+	if (task->timerNext) {
+		task->timerNext->timerPrev = prev;
+	}
+	/* If the task was the head of a slot, prev points into the slot array, so the slot can be
+		 found from it and marked as empty if this was the last task in it. */
+	OS_TCB_t ** const firstSlot = &wheel->slot[0][0];
+	if (prev >= firstSlot && prev < firstSlot + (_OS_WHEEL_LEVELS * _OS_WHEEL_SLOTS) && !*prev) {
+		uint32_t const slot = (uint32_t)(prev - firstSlot);
+		wheel->occupied[slot / _OS_WHEEL_SLOTS] &= ~(1UL << (slot % _OS_WHEEL_SLOTS));
+	}
+	task->timerPrev = 0;
+	task->timerNext = 0;
+	wheel->count--;
+}
+
+/* A function to advance the wheel up to the given time, cascading the higher level slots as their start
+	 times are reached and extracting the tasks in each level 0 slot. Function takes in a pointer to the
+	 wheel and the current time. Returns a list of the expired tasks linked through their timerNext fields,
+	 or NULL if no task has expired. */
+OS_TCB_t * OS_wheel_expire(OS_wheel_t * wheel, uint64_t now) {
+	OS_TCB_t * expired = 0;
+	while (wheel->time != now) {
+		/* Ticks on which nothing expires and nothing needs cascading can be skipped, so the wheel jumps
+			 straight to the next event. If that is past the current time (or the wheel is empty), it jumps
+			 to the current time instead. */
+		uint32_t const nextEvent = OS_wheel_nextExpiry(wheel);
+		if (nextEvent == UINT32_MAX || nextEvent > now - wheel->time) {
+			wheel->time = now;
+			break;
+		}
+		uint64_t const time = wheel->time + nextEvent;
+		wheel->time = time;
+		/* Cascade the slot of each level whose start time has been reached, lowest level first. A level
+			 is only reached if the time is also at a slot boundary of every level below it. */
+		for (uint_fast8_t level = 1; level < _OS_WHEEL_LEVELS; level++) {
+			if (time & ((1ULL << (_OS_WHEEL_SLOT_BITS * level)) - 1)) {
+				break;
+			}
+			OS_TCB_t * task = _wheel_detach(wheel, level, (time >> (_OS_WHEEL_SLOT_BITS * level)) & (_OS_WHEEL_SLOTS - 1));
+			while (task) {
+				// cache the next task, since placing the task overwrites its links
+				OS_TCB_t * const next = task->timerNext;
+				_wheel_place(wheel, task, time);
+				task = next;
+			}
+		}
+		// every task in the level 0 slot for this tick has expired
+		OS_TCB_t * task = _wheel_detach(wheel, 0, time & (_OS_WHEEL_SLOTS - 1));
+		while (task) {
+			OS_TCB_t * const next = task->timerNext;
+			task->timerPrev = 0;
+			task->timerNext = expired;
+			expired = task;
+			wheel->count--;
+			task = next;
+		}
+	}
+	return expired;
+}
+
+/* A function to find how many ticks away the next event in the wheel is: either the expiry of a task in
+	 level 0, or the start of an occupied slot in a higher level, which needs to be cascaded. Function takes
+	 in a pointer to the wheel. Returns UINT32_MAX if the wheel is empty. */
+uint32_t OS_wheel_nextExpiry(OS_wheel_t * wheel) {
+	uint32_t next = UINT32_MAX;
+	if (!wheel->count) {
+		return next;
+	}
+	for (uint_fast8_t level = 0; level < _OS_WHEEL_LEVELS; level++) {
+		uint32_t const occupied = wheel->occupied[level];
+		if (!occupied) {
+			continue;
+		}
+		uint_fast8_t const shift = _OS_WHEEL_SLOT_BITS * level;
+		// the first slot that has not yet been reached at this level
+		uint64_t const first = (wheel->time >> shift) + 1;
+		uint_fast8_t const index = first & (_OS_WHEEL_SLOTS - 1);
+		// rotate the bitmap so that bit 0 is that slot, then count the trailing zeros
+		uint32_t const rotated = index ? ((occupied >> index) | (occupied << (_OS_WHEEL_SLOTS - index))) : occupied;
+		uint32_t const distance = __CLZ(__RBIT(rotated));
+		// the event is the start of the occupied slot
+		uint32_t const ticks = (uint32_t)(((first + distance) << shift) - wheel->time);
+		if (ticks < next) {
+			next = ticks;
+		}
+	}
+	return next;
+}
@@ -0,0 +1,105 @@
+#include "OS/workqueue.h"
+#include "OS/eventflags.h"
+#include "OS/task.h"
+
+#include "stm32f4xx.h"
+
+/* Deferred work queue.
+
+	 Submitted items are pushed onto a singly linked stack with exclusive stores, which is safe against
+	 any number of ISRs and tasks submitting at once, since an exception between the exclusive load and
+	 store clears the monitor and makes the store fail. The worker takes the whole stack in one exchange,
+	 so it never contends with the submitters item by item, and reverses it to run the batch in the
+	 order it was submitted. The worker sleeps on an event flag, which is only set by the submit that
+	 finds the queue empty, so a burst of submits enters the kernel once, and a submit that finds items
+	 already queued knows the worker hasn't taken them yet and will see its item too. */
+
+#define _OS_WORKQUEUE_PENDING (1U << 0)
+
+static OS_work_t * volatile _head;
+static OS_eventFlags_t _pending;
+
+/* A function that takes every queued item off the stack, and returns them in the order they were
+	 submitted. */
+static OS_work_t * _work_take(void) {
+	OS_work_t * items;
+	while (1) {
+		items = (OS_work_t *) __LDREXW ((uint32_t volatile *)&_head);
+		if (!(__STREXW (0, (uint32_t volatile *)&_head))) {
+			break;
+		}
+	}
+	// the stack is newest first, reverse it
+	OS_work_t * ordered = 0;
+	while (items) {
+		OS_work_t * next = items->next;
+		items->next = ordered;
+		ordered = items;
+		items = next;
+	}
+	return ordered;
+}
+
+/* The worker task. It waits until work has been submitted, then runs every item that has been queued
+	 so far. Each item is marked as no longer queued before its function is called, so the function (or
+	 an ISR while it runs) can submit it again. */
+__attribute__((noreturn))
+static void _workqueue_worker(void const * const data) {
+	(void) data;
+	while (1) {
+		OS_eventFlags_wait(&_pending, _OS_WORKQUEUE_PENDING, OS_EVENTFLAGS_ANY | OS_EVENTFLAGS_CLEAR);
+		OS_work_t * work = _work_take();
+		while (work) {
+			OS_work_t * next = work->next;
+			work->next = 0;
+			work->queued = 0;
+			work->function(work->data);
+			work = next;
+		}
+	}
+}
+
+/* A function that creates the worker task and the event flag it waits on. Returns 1 if there was no
+	 block in the task pools for the worker, otherwise 0. */
+int_fast8_t OS_workqueue_initialise(void) {
+	_head = 0;
+	OS_eventFlags_initialise(&_pending);
+	return !OS_createTask(_workqueue_worker, 0, _OS_WORKQUEUE_PRIORITY, _OS_WORKQUEUE_STACK_WORDS);
+}
+
+/* A function that initialises an item of work, addressed by a pointer, in preparation for use. Function
+	 takes in a pointer to the item, and the function to run and its data. */
+void OS_work_initialise(OS_work_t * work, void (* function)(void * data), void * data) {
+	work->function = function;
+	work->data = data;
+	work->next = 0;
+	work->queued = 0;
+}
+
+/* A function that an ISR or task can use to queue an item of work. The item is first claimed with an
+	 exclusive store on its queued field, so that two submitters can't both link it in, and is then
+	 pushed onto the stack. Only the submit that finds the stack empty wakes the worker. Function takes in
+	 a pointer to the item. Returns 1 if the item was already queued, otherwise 0. */
+int_fast8_t OS_work_submit(OS_work_t * work) {
+	while (1) {
+		if (__LDREXW (&(work->queued))) {
+			__CLREX();
+			return 1;
+		}
+		if (!(__STREXW (1, &(work->queued)))) {
+			break;
+		}
+	}
+	OS_work_t * head;
+	while (1) {
+		head = (OS_work_t *) __LDREXW ((uint32_t volatile *)&_head);
+		work->next = head;
+		if (!(__STREXW ((uint32_t)work, (uint32_t volatile *)&_head))) {
+			break;
+		}
+	}
+	if (!head) {
+		OS_eventFlags_set(&_pending, _OS_WORKQUEUE_PENDING);
+	}
+	return 0;
+}
@@ -1,17 +1,24 @@
 #include "OS/mutex.h"
-#include "OS/semaphore.h"
+#include "OS/seqlock.h"
+#include "OS/eventflags.h"
+#include "OS/timer.h"
 #include "OS/os.h"
+#include "OS/task.h"
 #include "Utils/utils.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
 
-// initialise the mutexes and semaphores
+// initialise the mutexes and locks
 static OS_mutex_t consoleOutMutex;
-static OS_mutex_t tempSensorMutex;
-static OS_mutex_t heatingStatusMutex;
-static OS_semaphore_t readTempSemaphore;
+static OS_seqlock_t thermostatLock;
+
+/* event flags set when the temperatures change, so that the heating is
+	 only reconsidered when there is something new to act on. */
+static OS_eventFlags_t thermostatEvents;
+#define EVENT_CURRENT_TEMP (1UL << 0)
+#define EVENT_DESIRED_TEMP (1UL << 1)
 
 /* these variables store the temperature measurements and the thermostat only
 	 measures in positives, hence the unsigned type. */
@@ -24,26 +31,29 @@ static uint8_t heatingStatus = 0;			// 1=heating on, 0=off (initialised to off)
 	 variable, and finally logs the measurement to the serial output console. */
 __attribute__((noreturn))
 static void sense_temperature() {
+	// release time of the current period, so that readings stay exactly 10 seconds apart
+	uint64_t lastWake = OS_elapsedTicks64();
 	/* temperature must be sensed for an infinite number of times while the CPU
 		 is running. */
 	while (1) {
 		/* Generate a random 'temperature' value, emulating a thermometer. */
-		// get the temperature and exclusively store in global variable
-		OS_mutex_acquire(&tempSensorMutex);
-		currentTemp = (uint8_t)(rand() % 28 + 15);
-		OS_mutex_release(&tempSensorMutex);
+		uint8_t measuredTemp = (uint8_t)(rand() % 28 + 15);
+		// store the temperature in the global variable under the sequence lock
+		OS_seqlock_writeBegin(&thermostatLock);
+		currentTemp = measuredTemp;
+		OS_seqlock_writeEnd(&thermostatLock);
+		OS_eventFlags_set(&thermostatEvents, EVENT_CURRENT_TEMP);
 		/* Log to the console that a temperature reading has been recorded. */
-		// exclusive access to the console with mutex
-		OS_mutex_acquire(&consoleOutMutex);
-		// semaphore access the current temp variable to read
-		OS_semaphore_acquire(&readTempSemaphore);
-		// print the current temp reading to console
-		printf("sense_temperature: Measured a temperature reading of %" PRId8 "*C \n\n\n", currentTemp);
-		// release both the temp variable semaphore and console mutex
-		OS_semaphore_release(&readTempSemaphore);
-		OS_mutex_release(&consoleOutMutex);
-		/* Wait for 10 seconds until taking the next temperature reading. */
-		OS_sleep(10000);
+		/* exclusive access to the console with mutex. A faulty device thread
+			 can hog the console, so the log is skipped rather than letting it
+			 hold up the readings if the console isn't free within a second. */
+		if (!OS_mutex_acquire_timeout(&consoleOutMutex, 1000)) {
+			// print the current temp reading to console
+			printf("sense_temperature: Measured a temperature reading of %" PRId8 "*C \n\n\n", measuredTemp);
+			OS_mutex_release(&consoleOutMutex);
+		}
+		/* Wait until 10 seconds after the last reading to take the next one. */
+		OS_sleepUntil(&lastWake, 10000);
 	}
 }
 
@@ -53,32 +63,37 @@ static void sense_temperature() {
 __attribute__((noreturn))
 static void control_heating() {
 	while (1) {
-		// reading the temp variables exclusively with the semaphore
-		OS_semaphore_acquire(&readTempSemaphore);
-		if (desiredTemp > currentTemp) {
+		/* the heater only needs to be switched when either temperature has
+			 changed, so wait for that rather than polling, consuming the events. */
+		OS_eventFlags_wait(&thermostatEvents, EVENT_CURRENT_TEMP | EVENT_DESIRED_TEMP,
+		                   OS_EVENTFLAGS_ANY | OS_EVENTFLAGS_CLEAR);
+		// read the temp variables, retrying if they were written meanwhile
+		uint8_t currentTempToCompare, desiredTempToCompare;
+		uint32_t sequence;
+		do {
+			sequence = OS_seqlock_readBegin(&thermostatLock);
+			currentTempToCompare = currentTemp;
+			desiredTempToCompare = desiredTemp;
+		} while (OS_seqlock_readRetry(&thermostatLock, sequence));
+		if (desiredTempToCompare > currentTempToCompare) {
 			// turn heating on if the desired is higher than the current temp
-			OS_mutex_acquire(&heatingStatusMutex);
+			OS_seqlock_writeBegin(&thermostatLock);
 			heatingStatus = 1;
-			OS_mutex_release(&heatingStatusMutex);
+			OS_seqlock_writeEnd(&thermostatLock);
 			// log this event to console via serial
 			OS_mutex_acquire(&consoleOutMutex);
 			printf("control_boiler: Heating has been turned on \n\n\n");
 			OS_mutex_release(&consoleOutMutex);
 		} else {
 			// if the desired is equal to or less than current temp, heating off
-			OS_mutex_acquire(&heatingStatusMutex);
+			OS_seqlock_writeBegin(&thermostatLock);
 			heatingStatus = 0;
-			OS_mutex_release(&heatingStatusMutex);
+			OS_seqlock_writeEnd(&thermostatLock);
 			// log this event to console via serial
 			OS_mutex_acquire(&consoleOutMutex);
 			printf("control_heating: Heating has been turned off \n\n\n");
 			OS_mutex_release(&consoleOutMutex);
 		}
-		// release the read temp semaphore
-		OS_semaphore_release(&readTempSemaphore);
-		/* this logic which checks whether the heater needs to be on or off
-			 must try to run every 15 seconds. */
-		OS_sleep(15000);
 	}
 }
 
@@ -93,33 +108,31 @@ static void display_LCD(uint8_t data1, uint8_t data2, uint8_t data3) {
 		OS_mutex_release(&consoleOutMutex);
 }
 
-/* This task is used to broadcast the data to various outputs such as LCD
-	 displays and other peripherals. */
-__attribute__((noreturn))
-static void broadcast_data() {
-	while (1) {
-		// access and read temps using semaphore
-		OS_semaphore_acquire(&readTempSemaphore);
-		uint8_t currentTempToDisplay = currentTemp;
-		uint8_t desiredTempToDisplay = desiredTemp;
-		OS_semaphore_release(&readTempSemaphore);
-		
-		// access the heating status bus using mutex
-		OS_mutex_acquire(&heatingStatusMutex);
-		uint8_t heatingStatusToDisplay = heatingStatus;
-		OS_mutex_release(&heatingStatusMutex);
-		
-		// output to console via mutex
-		OS_mutex_acquire(&consoleOutMutex);
-		printf("broadcast_data: Curr.: %" PRId8 "*C, Desi.: %" PRId8 "*C, Heat.: %" PRId8 " \n\n\n",
-						currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay);
-		display_LCD(currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay);
-		// Other peripherals...
-		OS_mutex_release(&consoleOutMutex);
-		
-		// run every 3 seconds
-		OS_sleep(3000);
+/* This timer callback is used to broadcast the data to various outputs such
+	 as LCD displays and other peripherals. It runs every 3 seconds from the timer
+	 daemon, rather than needing a task and stack of its own. */
+static void broadcast_data(OS_timer_t * timer) {
+	(void) timer;
+	// read the temps and heating status, retrying if they were written meanwhile
+	uint8_t currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay;
+	uint32_t sequence;
+	do {
+		sequence = OS_seqlock_readBegin(&thermostatLock);
+		currentTempToDisplay = currentTemp;
+		desiredTempToDisplay = desiredTemp;
+		heatingStatusToDisplay = heatingStatus;
+	} while (OS_seqlock_readRetry(&thermostatLock, sequence));
+	
+	/* output to console via mutex. Timer callbacks mustn't hold up the other
+		 timers, so this broadcast is skipped if the console is being hogged. */
+	if (OS_mutex_acquire_timeout(&consoleOutMutex, 1000)) {
+		return;
 	}
+	printf("broadcast_data: Curr.: %" PRId8 "*C, Desi.: %" PRId8 "*C, Heat.: %" PRId8 " \n\n\n",
+					currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay);
+	display_LCD(currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay);
+	// Other peripherals...
+	OS_mutex_release(&consoleOutMutex);
 }
 
 /* This task emulates a thread for a remote device controlling the heating
@@ -131,27 +144,25 @@ static void control_thread_dev1() {
 	
 	// starts working 5 seconds into the emulation
 	OS_sleep(5000);
+	// release time of the current period
+	uint64_t lastWake = OS_elapsedTicks64();
 	while (1) {
-		// retrieve the desired and current temperature
-		OS_semaphore_acquire(&readTempSemaphore);
-		uint8_t currentTempToDisplay = currentTemp;
-		uint8_t desiredTempToDisplay = desiredTemp;
-		OS_semaphore_release(&readTempSemaphore);
-		
-		// retrieve the heating status
-		OS_mutex_acquire(&heatingStatusMutex);
-		uint8_t heatingStatusToDisplay = heatingStatus;
-		OS_mutex_release(&heatingStatusMutex);
+		// retrieve the desired and current temperature, and the heating status
+		uint8_t currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay;
+		uint32_t sequence;
+		do {
+			sequence = OS_seqlock_readBegin(&thermostatLock);
+			currentTempToDisplay = currentTemp;
+			desiredTempToDisplay = desiredTemp;
+			heatingStatusToDisplay = heatingStatus;
+		} while (OS_seqlock_readRetry(&thermostatLock, sequence));
 		
-		// set the desired temperature
-		OS_mutex_acquire(&tempSensorMutex);
-		desiredTemp = loopCounter++;
-		OS_mutex_release(&tempSensorMutex);
-		
-		// retrieve newly set desired temp
-		OS_semaphore_acquire(&readTempSemaphore);
-		uint8_t newDesiredTempToDisplay = desiredTemp;
-		OS_semaphore_release(&readTempSemaphore);
+		// set the desired temperature, keeping a copy to display
+		uint8_t newDesiredTempToDisplay = loopCounter++;
+		OS_seqlock_writeBegin(&thermostatLock);
+		desiredTemp = newDesiredTempToDisplay;
+		OS_seqlock_writeEnd(&thermostatLock);
+		OS_eventFlags_set(&thermostatEvents, EVENT_DESIRED_TEMP);
 		
 		// log to the console
 		OS_mutex_acquire(&consoleOutMutex);
@@ -160,7 +171,7 @@ static void control_thread_dev1() {
 		OS_mutex_release(&consoleOutMutex);
 		
 		// change temp another time after 10 seconds
-		OS_sleep(10000);
+		OS_sleepUntil(&lastWake, 10000);
 	}
 }
 
@@ -169,27 +180,25 @@ static void control_thread_dev1() {
 static void control_thread_dev2() {	
 	// starts working 10 seconds into the emulation
 	OS_sleep(10000);
+	// release time of the current period
+	uint64_t lastWake = OS_elapsedTicks64();
 	for (uint8_t i = 0; i < 4; ++i) {
-		// retrieve the desired and current temperature
-		OS_semaphore_acquire(&readTempSemaphore);
-		uint8_t currentTempToDisplay = currentTemp;
-		uint8_t desiredTempToDisplay = desiredTemp;
-		OS_semaphore_release(&readTempSemaphore);
-		
-		// retrieve the heating status
-		OS_mutex_acquire(&heatingStatusMutex);
-		uint8_t heatingStatusToDisplay = heatingStatus;
-		OS_mutex_release(&heatingStatusMutex);
+		// retrieve the desired and current temperature, and the heating status
+		uint8_t currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay;
+		uint32_t sequence;
+		do {
+			sequence = OS_seqlock_readBegin(&thermostatLock);
+			currentTempToDisplay = currentTemp;
+			desiredTempToDisplay = desiredTemp;
+			heatingStatusToDisplay = heatingStatus;
+		} while (OS_seqlock_readRetry(&thermostatLock, sequence));
 		
-		// set the desired temperature
-		OS_mutex_acquire(&tempSensorMutex);
-		desiredTemp = i;
-		OS_mutex_release(&tempSensorMutex);
-		
-		// retrieve newly set desired temp
-		OS_semaphore_acquire(&readTempSemaphore);
-		uint8_t newDesiredTempToDisplay = desiredTemp;
-		OS_semaphore_release(&readTempSemaphore);
+		// set the desired temperature, keeping a copy to display
+		uint8_t newDesiredTempToDisplay = i;
+		OS_seqlock_writeBegin(&thermostatLock);
+		desiredTemp = newDesiredTempToDisplay;
+		OS_seqlock_writeEnd(&thermostatLock);
+		OS_eventFlags_set(&thermostatEvents, EVENT_DESIRED_TEMP);
 		
 		// log to the console
 		OS_mutex_acquire(&consoleOutMutex);
@@ -197,8 +206,8 @@ static void control_thread_dev2() {
 						currentTempToDisplay, desiredTempToDisplay, heatingStatusToDisplay, newDesiredTempToDisplay);
 		OS_mutex_release(&consoleOutMutex);
 		
-		// change temp another time after 10 seconds
-		OS_sleep(15000);
+		// change temp another time after 15 seconds
+		OS_sleepUntil(&lastWake, 15000);
 	}
 }
 
@@ -225,15 +234,12 @@ int main(void) {
 	
 	printf("\r\nDocetOS\r\n\n\n");
 
-	/* Reserve memory for two stacks and two TCBs.
+	/* Reserve memory for three stacks and three TCBs.
 	   Remember that stacks must be 8-byte aligned. */
 	static uint32_t stack1[128] __attribute__ (( aligned(8) ));
 	static uint32_t stack2[128] __attribute__ (( aligned(8) ));
-	static uint32_t stack3[128] __attribute__ (( aligned(8) ));
 	static uint32_t stack4[128] __attribute__ (( aligned(8) ));
-	static uint32_t stack5[128] __attribute__ (( aligned(8) ));
-	static uint32_t stack6[128] __attribute__ (( aligned(8) ));
-	static OS_TCB_t TCB1, TCB2, TCB3, TCB4, TCB5, TCB6;
+	static OS_TCB_t TCB1, TCB2, TCB4;
 
 	/* sense_temperature TCB must be of highest priority since the
 		 main task of a thermostat is to measure the temperature. */
@@ -243,49 +249,60 @@ int main(void) {
 		 other main task of a thermostat is to toggle the heating. */
 	OS_initialiseTCB(&TCB2, stack2+128, control_heating, NULL, 1);
 	
-	/* broadcast_data TCB must be the same priority as the sense and
-		 control TCBs, since it's important to output data for users to
-		 observe system. */
-	OS_initialiseTCB(&TCB3, stack3+128, broadcast_data, NULL, 1);
-	
-	/* control_thread_dev1 TCB is of lower priority than the three prior
-		 defined tasks, this task emulates a remote device that changes the
+	/* control_thread_dev1 TCB is of lower priority than the two prior
+		 defined tasks and the timer daemon, this task emulates a remote device that changes the
 		 desired temps every 10 seconds. */
 	OS_initialiseTCB(&TCB4, stack4+128, control_thread_dev1, NULL, 2);
 	
+	/* Add the tasks to the scheduler */
+	OS_addTask(&TCB1);
+	OS_addTask(&TCB2);
+	OS_addTask(&TCB4);
+	
+	/* control_thread_dev2 and control_thread_dev3 both finish after a
+		 while, so they are created from the task pools rather than given
+		 static stacks and TCBs, and their memory is recycled when they exit. */
+	
 	/* control_thread_dev2 TCB is of lower priority than device 1 defined
 		 tasks, this task emulates a remote device that changes the desired
 		 temps every 15 seconds. */
-	OS_initialiseTCB(&TCB5, stack5+128, control_thread_dev2, NULL, 3);
+	OS_TCB_t * dev2TCB = OS_createTask(control_thread_dev2, NULL, 3, 128);
+	
+	/* Device 1 and device 2 both only update the desired temps and print
+		 a line while holding the console mutex, so there's no benefit in
+		 device 1 preempting device 2 part-way through. Raising device 2's
+		 preemption threshold to device 1's priority groups them together.
+		 The task is already in the scheduler, but the OS hasn't started.
+		 There may have been no pool block left for it. */
+	if (dev2TCB) {
+		OS_setPreemptionThreshold(dev2TCB, 2);
+	}
 	
 	/* control_thread_dev3 TCB is of the lowest priority and emulates a
 		 badly implemented device thread, which is hogging the serial mutex
 		 due to a connection issue. */
-	OS_initialiseTCB(&TCB6, stack6+128, control_thread_dev3, NULL, 4);
-	
-	/* Add the tasks to the scheduler */
-	OS_addTask(&TCB1);
-	OS_addTask(&TCB2);
-	OS_addTask(&TCB3);
-	OS_addTask(&TCB4);
-	OS_addTask(&TCB5);
-	OS_addTask(&TCB6);
+	OS_createTask(control_thread_dev3, NULL, 4, 128);
 	
 	/* only one thread can access the console output at a given
 		 time to ensure individual use of the serial port, eliminating
 		 scrambled outputs. */
 	OS_mutex_initialise(&consoleOutMutex);
-	/* only one thread can write to the global temperature reading
-		 storage variable to prevent data corruption. */
-	OS_mutex_initialise(&tempSensorMutex);
-	/* only one thread can send data to the heater at a given time
-		 due to the nature of the data bus used for communication with
-		 the heater. */
-	OS_mutex_initialise(&heatingStatusMutex);
+	/* the temperature variables and heating status are read by every
+		 task but written rarely, and are only a few bytes, so they share
+		 a sequence lock. Readers just retry their copy if it overlapped a
+		 write, and never block or enter the kernel. */
+	OS_seqlock_initialise(&thermostatLock);
+	/* control_heating waits on these rather than running periodically. */
+	OS_eventFlags_initialise(&thermostatEvents);
 	
-	/* initialise the semaphore that's used to read the temperature
-		 variables - a max of 3 concurrent reads should be permitted. */
-	OS_semaphore_initialise(&readTempSemaphore, 3);
+	/* broadcast_data runs every 3 seconds from an auto-reload timer. The
+		 timer daemon runs at the same priority as the sense and control
+		 tasks, since it's important to output data for users to observe
+		 the system, and it can run other periodic jobs on the same stack. */
+	static OS_timer_t broadcastTimer;
+	OS_timer_initialiseDaemon();
+	OS_timer_initialise(&broadcastTimer, broadcast_data, NULL, 3000, 1);
+	OS_timer_start(&broadcastTimer);
 	
 	/* Start the OS */
 	OS_start();